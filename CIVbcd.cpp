@@ -0,0 +1,52 @@
+/*
+	CIVbcd.cpp - Library for communication via ICOM's CI-V bus
+	Released into the public domain
+
+	Conversion between BCD coded fields and binary values (see CIVbcd.h)
+*/
+
+
+#if defined(ARDUINO)
+	#include <Arduino.h>
+#endif
+
+#include "CIVcmds.h"
+#include "CIVmaster.h"
+
+#ifdef bigRamAv
+
+// tables generated at compile time
+#define CIV_BCD_D(b)		uint8_t(((b)>>4)*10 + ((b)&0x0F))
+#define CIV_BCD_D4(b)		CIV_BCD_D(b),CIV_BCD_D((b)+1),CIV_BCD_D((b)+2),CIV_BCD_D((b)+3)
+#define CIV_BCD_D16(b)	CIV_BCD_D4(b),CIV_BCD_D4((b)+4),CIV_BCD_D4((b)+8),CIV_BCD_D4((b)+12)
+#define CIV_BCD_D64(b)	CIV_BCD_D16(b),CIV_BCD_D16((b)+16),CIV_BCD_D16((b)+32),CIV_BCD_D16((b)+48)
+
+const uint8_t CIVbcd::_bcd2bin[256] {CIV_BCD_D64(0),CIV_BCD_D64(64),CIV_BCD_D64(128),CIV_BCD_D64(192)};
+
+#define CIV_BCD_E(v)		uint8_t((((v)/10)<<4) | ((v)%10))
+#define CIV_BCD_E10(v)	CIV_BCD_E(v),CIV_BCD_E((v)+1),CIV_BCD_E((v)+2),CIV_BCD_E((v)+3),CIV_BCD_E((v)+4), \
+												CIV_BCD_E((v)+5),CIV_BCD_E((v)+6),CIV_BCD_E((v)+7),CIV_BCD_E((v)+8),CIV_BCD_E((v)+9)
+
+const uint8_t CIVbcd::_bin2bcd[100] {
+	CIV_BCD_E10(0), CIV_BCD_E10(10),CIV_BCD_E10(20),CIV_BCD_E10(30),CIV_BCD_E10(40),
+	CIV_BCD_E10(50),CIV_BCD_E10(60),CIV_BCD_E10(70),CIV_BCD_E10(80),CIV_BCD_E10(90)
+};
+
+#undef CIV_BCD_E10
+#undef CIV_BCD_E
+#undef CIV_BCD_D64
+#undef CIV_BCD_D16
+#undef CIV_BCD_D4
+#undef CIV_BCD_D
+
+#endif
+
+//:::::::::
+bool CIVbcd::isValid(const uint8_t bcd[], const uint8_t len) {
+
+	for (uint8_t idx=0; idx<len; idx++) {
+		if (((bcd[idx]&0x0F)>9) || ((bcd[idx]>>4)>9)) return false;
+	}
+	return true;
+
+}
@@ -0,0 +1,93 @@
+/*
+	CIVbcd.h - Library for communication via ICOM's CI-V bus
+	Released into the public domain
+
+	Conversion between BCD coded fields of the CI-V messages and binary values.
+	Two digits (one byte) are converted in one step (lookup tables, if bigRamAv).
+	Fields of up to 8 bytes (16 digits) are supported, the results are up to 64 bit wide,
+	e.g. 6 byte frequencies > 4.29 GHz (which don't fit into an unsigned long).
+
+	digit order of the field:
+		CIV_bcdBigEndian			the first byte is of highest order (e.g. 2 byte data, time, date)
+		CIV_bcdLittleEndian		the first byte is of lowest order  (e.g. frequencies)
+
+	e.g.
+		uint64_t freq = CIVbcd::decode(&msg.datafield[1], msg.datafield[0], CIV_bcdLittleEndian);
+		CIVbcd::encode(2022, &date[1], 2, CIV_bcdBigEndian);		// -> 0x20 0x22
+
+	This file will be included by CIVmaster.h automatically.
+*/
+#ifndef CIVbcd_h
+#define CIVbcd_h
+
+
+enum CIVbcdOrder_t:uint8_t {
+	CIV_bcdBigEndian = 0,
+	CIV_bcdLittleEndian
+};
+
+class CIVbcd {
+
+public:
+
+	static constexpr uint8_t maxLength = 8;				// max. length of a BCD field [bytes]
+
+	//::::::::::::: one byte (two digits)
+	static uint8_t	toBin(const uint8_t bcd) {
+#ifdef bigRamAv
+		return _bcd2bin[bcd];
+#else
+		return (bcd>>4)*10 + (bcd&0x0F);
+#endif
+	}
+
+	static uint8_t	toBcd(const uint8_t bin) {					// bin: 0..99
+#ifdef bigRamAv
+		return _bin2bcd[bin];
+#else
+		return ((bin/10)<<4) | (bin%10);
+#endif
+	}
+
+	//::::::::::::: BCD field -> binary value (len: 1..maxLength)
+	template <typename T = uint64_t>
+	static T				decode(const uint8_t bcd[], uint8_t len, const CIVbcdOrder_t order) {
+		T value = 0;
+
+		if (len>maxLength) len = maxLength;
+		if (order==CIV_bcdLittleEndian)
+			while (len>0) value = value*100 + toBin(bcd[--len]);
+		else
+			for (uint8_t idx=0; idx<len; idx++) value = value*100 + toBin(bcd[idx]);
+		return value;
+	}
+
+	//::::::::::::: binary value -> BCD field (len: 1..maxLength; higher digits, which don't fit, are lost)
+	template <typename T>
+	static void			encode(T value, uint8_t bcd[], uint8_t len, const CIVbcdOrder_t order) {
+		if (len>maxLength) len = maxLength;
+		if (order==CIV_bcdLittleEndian)
+			for (uint8_t idx=0; idx<len; idx++)	{bcd[idx] = toBcd(uint8_t(value%100)); value /= 100;}
+		else
+			while (len>0)												{bcd[--len] = toBcd(uint8_t(value%100)); value /= 100;}
+	}
+
+	//::::::::::::: check, whether all digits are 0..9
+	static bool			isValid(const uint8_t bcd[], const uint8_t len);
+
+	//::::::::::::: frequency (any length up to maxLength) of a received message (e.g. CIV_C_F_SEND)
+	static uint64_t	frequency(const CIVresult_t &msg) {
+		return decode(&msg.datafield[1], msg.datafield[0], CIV_bcdLittleEndian);
+	}
+
+private:
+
+#ifdef bigRamAv
+	static const uint8_t _bcd2bin[256];
+	static const uint8_t _bin2bcd[100];
+#endif
+
+}; // end class CIVbcd
+
+
+#endif
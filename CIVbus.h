@@ -0,0 +1,505 @@
+/*
+	CIVbus.h - Library for communication via ICOM's CI-V bus
+	Released into the public domain
+
+	Class template CIVbus: the interface dependent part of CIV.
+	The interface (transport, see CIVtransport.h) is a template parameter, i.e. the access to the
+	single bytes is resolved at compile time; a program, which is using the serial interface only,
+	doesn't contain any Bluetooth code and vice versa.
+
+	e.g.
+		CIV civ;															// default interface of the board (see CIVmaster.h)
+		CIVbus<CIVbtTransport>	civBT;				// ESP32: Bluetooth only
+		CIVbus<CIVptyTransport>	civPty;			// Linux host: tty or pseudo terminal
+		CIVbus<CIVserialTransport> civ1(Serial1);	// an interface other than the default one
+
+	This file will be included by CIVmaster.h automatically.
+*/
+#ifndef CIVbus_h
+#define CIVbus_h
+
+
+template <class Transport>
+class CIVbus : public CIVbase {
+
+public:
+
+//ctor = constructor
+	CIVbus()																{}
+	template <class Arg>
+	explicit CIVbus(Arg &arg) : _transport(arg)	{}	// the interface of this bus, e.g. Serial1
+	/*
+	Every CIVbus owns its transport, its buffers, mailboxes, statistics and trace, i.e. several
+	instances on different interfaces are independent of each other.
+	e.g.
+		CIVbus<CIVserialTransport>	civA(Serial1);		// Mega2560: two buses
+		CIVbus<CIVserialTransport>	civB(Serial2);
+		ICradio	ic7300(TypeIC7300, CIV_ADDR_7300, civA);
+		ICradio	ic9700(TypeIC9700, CIV_ADDR_9700, civB);
+	*/
+
+#ifdef useHost
+	~CIVbus()																{stopRxThread();}
+#endif
+
+//------------------------------------------------------------------------
+// public member functions
+
+	//::::::::::::: initialisation of the class CIV
+  void    setupp()															{beginIF(false,BT_NAME);}
+	// only Serial1, Serial2 or AltSoftSerial supported, NO BT!
+
+  void    setupp(bool ESP_BT)										{beginIF(ESP_BT,BT_NAME);}
+	// if a true is passed to CIV and the transport supports it (ESP32) -> BT will be used
+
+  void    setupp(bool ESP_BT,String BTname)	{beginIF(ESP_BT,BTname.c_str());}
+	// if a true is passed to CIV and it's running on an ESP -> BT with id BTname will be used
+	// Note: Pls delete the BT-object in the IC705 pairing menu and perform a new
+	// pairing every time you change this name - otherwise you won't see
+	// this change in the IC705!
+
+  void    setupp(CIVbaud_t baudrate)						{beginIF(false,BT_NAME,baudrate);}
+	// Serial1, Serial2 or AltSoftSerial with the baudrate of the radio (e.g. CIV_baud115200)
+
+	//::::::::::::: change the baudrate of the serial interface at runtime (ignored, if BT is in use)
+	void		setBaudrate(CIVbaud_t baudrate);
+	/*
+	All waiting times of the bus are derived from the baudrate (see timing()), i.e. at 115200Bd
+	a transaction takes approx. 1/6 of the time at 19200Bd.
+	*/
+
+	//::::::::::::: find out the baudrate of the radio
+	CIVbaud_t	autoBaud(const uint8_t deviceAddr);
+	/*
+	The ID query (CIV_C_TRX_ID) is sent to deviceAddr at the standard baudrates (19200 first, then 115200,
+	9600, 57600, 38400, 4800), until the radio answers within t_usAutoBaud.
+	The interface is left at the baudrate found; if there's no answer at all: CIV_BAUDRATE, CIV_baudNone is returned.
+	e.g.
+		civ.setupp();
+		if (civ.autoBaud(CIV_ADDR_7300)==CIV_baudNone) Serial.println("no radio");
+	Note: messages of deviceAddr received meanwhile are discarded.
+	*/
+
+	//::::::::::::: the interface in use (e.g. for feeding the bytes of CIVmemTransport)
+	Transport &transport()												{return _transport;}
+
+	//::::::::::::: use a receive ringbuffer (CIVrxRing) instead of polling the serial interface
+	void		useRxRing(CIVrxRing &rxRing)
+		{_rxRing = &rxRing; _rxRing->setAddrFilter(addrFilter()); _rxRing->setFrameTimeout(_timing.t_usRxFrame);
+		 _transport.attachRxRing(rxRing);}
+	/*
+	From now on, the bytes are pushed into rxRing in the background (i.e. independently from the calls of readMsg)
+		ESP32:  by the callback of Serial2 (onReceive) or BluetoothSerial (onData) -> call after setupp!
+		host:		by a reader thread (startRxThread)
+		others: by the application (e.g. a timer ISR), calling rxRing.push(...)
+	readMsgRaw only takes the completed frames out of the ringbuffer.
+	*/
+
+#ifdef useHost
+	void		startRxThread();										// start a thread reading the serial interface into the rxRing
+	void		stopRxThread();
+#endif
+
+	// see CIVbase
+	CIVresult_t writeMsg (const uint8_t deviceAddr, const uint8_t cmd_body[], const uint8_t cmd_data[],writeMode_t mode);
+	void		txService();
+
+protected:
+
+	void		receive(CIVresult_t &CIVresultL);
+
+private:
+//------------------------------------------------------------------------
+// private methods
+
+	void		beginIF(bool ESP_BT, const char BTname[], const unsigned long baudrate = CIV_BAUDRATE);
+	void		sendMsg(const uint8_t txBuffer[], const writeMode_t mode, CIVresult_t &CIVresultL);	// one attempt of writeMsg
+
+	void		wakeup() {														// wakeup radio: (40)*C_START
+		uint8_t preamble[40];
+		memset(preamble, C_START, sizeof(preamble));
+		_transport.write(preamble, sizeof(preamble));
+	}
+
+	bool		busBusy()															// a frame is just being received
+		{return (_rxRing!=NULL) ? _rxRing->busy() :
+						((_rxChunkIdx<_rxChunkLen) || (_transport.available()>0) || (_rxFramer.busy()));}
+
+	bool		rxUnread()														// bytes/frames received, but not read yet (e.g. an echo)
+		{return (_rxRing!=NULL) ? ((_rxRing->count()>0) || _rxRing->busy()) :
+						((_rxChunkIdx<_rxChunkLen) || (_transport.available()>0));}
+
+//------------------------------------------------------------------------
+// private variables
+
+	Transport					_transport;
+	bool							_useBT = false;
+
+	// chunk read at once from the interface (only if the transport supports it)
+	uint8_t						_rxChunk[Transport::hasReadBuf ? CIVrxChunkSize : 1];
+	uint16_t					_rxChunkIdx = 0;
+	uint16_t					_rxChunkLen = 0;
+
+#ifdef useHost
+	std::thread				_rxThread;
+	std::atomic<bool>	_rxThreadRun {false};
+#endif
+
+}; // end class CIVbus
+
+
+//------------------------------------------------------------------------
+// public methods
+
+
+//::::::::: initialize the HW /Interfaces
+template <class Transport>
+void CIVbus<Transport>::beginIF(bool ESP_BT, const char BTname[], const unsigned long baudrate) {
+
+	_useBT = ESP_BT && Transport::hasBT;
+	if (_useBT) {													// initialize BT if required (ESP only)
+		_transport.beginBT(BTname);
+		setTiming(CIV_BAUDRATE);
+	}
+	else {																// initialize Altsoftserial, Serial1 or Serial2
+		_transport.begin(baudrate);
+		setTiming(baudrate);
+	}
+
+}
+
+//::::::::: change the baudrate at runtime
+template <class Transport>
+void CIVbus<Transport>::setBaudrate(CIVbaud_t baudrate) {
+
+	if (_useBT || (baudrate==CIV_baudNone)) return;
+
+	_transport.flushOutput();
+	_transport.begin(baudrate);
+	setTiming(baudrate);
+
+	if (_rxRing==NULL) {									// bytes received at the old baudrate are garbage
+		while (_transport.available()>0) _transport.read();
+		_rxChunkIdx = _rxChunkLen = 0;
+		_rxFramer.reset();
+	}
+
+}
+
+//::::::::: find out the baudrate of the radio
+template <class Transport>
+CIVbaud_t CIVbus<Transport>::autoBaud(const uint8_t deviceAddr) {
+
+	static const CIVbaud_t baudrates[] = {CIV_baud19200, CIV_baud115200, CIV_baud9600,
+																				CIV_baud57600, CIV_baud38400, CIV_baud4800};
+	bool known = isAddrKnown(deviceAddr);
+	CIVbaud_t found = CIV_baudNone;
+	unsigned long ts_sent;
+	uint8_t idx;
+
+	if (_useBT) return CIVbaud_t(_timing.baudrate);
+
+	if (!known) registerAddr(deviceAddr);							// otherwise the answer would be filtered out
+
+	for (idx=0; (idx<sizeof(baudrates)/sizeof(baudrates[0])) && (found==CIV_baudNone); idx++) {
+		setBaudrate(baudrates[idx]);
+		writeMsg(deviceAddr,CIV_C_TRX_ID,CIV_D_NIX,CIV_wFast);
+		ts_sent = micros();
+		while (((micros()-ts_sent) < t_usAutoBaud) && (found==CIV_baudNone)) {
+			CIVmsgRef msg = readMsgRef(deviceAddr);
+			if ((msg->retVal==CIV_OK_DAV) && (msg->cmd[1]==CIV_C_TRX_ID[1]) && (msg->cmd[2]==CIV_C_TRX_ID[2]))
+				found = baudrates[idx];
+			else
+				delayMicroseconds(t_usLoop);
+		}
+	}
+	if (found==CIV_baudNone) setBaudrate(CIVbaud_t(CIV_BAUDRATE));
+
+	if (!known) unregisterAddr(deviceAddr);
+	return found;
+
+}
+
+#ifdef useHost
+
+//::::::::::::: reader thread on the host: serial interface -> rxRing
+template <class Transport>
+void CIVbus<Transport>::startRxThread() {
+
+	if ((_rxRing==NULL) || (_rxThreadRun)) return;
+
+	_rxThreadRun = true;
+	_rxThread = std::thread([this]() {
+		uint8_t buf[CIV_BUFFERSIZE];
+		size_t	len;
+
+		while (_rxThreadRun) {
+			len = _transport.readWait(buf,sizeof(buf),1000);
+			if (len>0) _rxRing->push(buf,len);
+		}
+	});
+
+}
+
+template <class Transport>
+void CIVbus<Transport>::stopRxThread() {
+
+	_rxThreadRun = false;
+	if (_rxThread.joinable()) _rxThread.join();
+
+}
+
+#endif
+
+//:::::::::
+template <class Transport>
+void CIVbus<Transport>::receive(CIVresult_t &CIVresultL) {
+
+// read the data (complete commands)coming in from every radio connected to the CIV Bus
+// output: info about success (CIV_OK, CIV_OK_DAV, CIV_NOK,CIV_NO_MSG, CIV_MSG_PENDING)+Data eventually
+//         in CIVresultL (the answer from the radio is decoded directly into CIVresultL)
+//
+// Only the bytes already available in the serial interface are processed, i.e. there is no waiting
+// for the rest of a frame. The state of the receiver is kept in _rxFramer until the next call.
+
+  uint8_t inByte;
+
+  CIVresultL.retVal       = CIV_OK;
+  CIVresultL.address      = CIV_ADDR_NONE;
+  CIVresultL.cmd[0]       = 0;
+  CIVresultL.datafield[0] = 0;
+  CIVresultL.value        = 0;
+
+  #ifdef debugWithoutRadio
+
+    // various test patterns
+    constexpr uint8_t rxBufDummy[] = { 6,C_START,C_START,0xE0,0x94, C_OK,C_STOP};                           // OK
+//    constexpr uint8_t rxBufDummy[] = { 6,C_START,C_START,0xE0,0x94,C_NOK,C_STOP};                           // NOK
+//		constexpr uint8_t rxBufDummy[] = {11,C_START,C_START,0xE0,0x94,0x00,0x89,0x67,0x45,0x23,0x01,C_STOP};   // OK_DAV
+
+		(void)inByte;
+		decodeMsg(rxBufDummy, CIVresultL);
+
+  #else
+		txService();																// send the queued commands, if the bus is free
+		reqService();																// deadlines of the pending requests
+
+		if (_rxRing!=NULL) {readRing(CIVresultL); return;}	// the frames are collected in the background
+
+		//.... receive the answer of the radio (exactly ONE message, as far as the bytes are available)
+
+		if (Transport::hasReadBuf) {									// bulk ingest: chunk by chunk
+			while (true) {
+				if (_rxChunkIdx==_rxChunkLen) {
+					_rxChunkIdx = 0;
+					_rxChunkLen = _transport.readBuf(_rxChunk,sizeof(_rxChunk));
+					if (_rxChunkLen==0) break;
+				}
+				if (txEcho(_rxChunk[_rxChunkIdx])) {_rxChunkIdx++; continue;}	// echo of a command sent by writeMsgAsync
+				_rxChunkIdx += _rxFramer.collect(&_rxChunk[_rxChunkIdx], _rxChunkLen-_rxChunkIdx);
+				if (_rxFramer.state==CIV_stop) {						// Stop byte received -> frame complete
+					decodeMsg(_rxFramer.rxBuffer, CIVresultL); return;
+				}
+			}
+		}
+		else
+		while (_transport.available()>0) {
+			inByte = _transport.read();
+			if (txEcho(inByte)) continue;									// echo of a command sent by writeMsgAsync
+			if (_rxFramer.collect(inByte)) {							// Stop byte received -> frame complete
+				decodeMsg(_rxFramer.rxBuffer, CIVresultL); return;
+			}
+		}
+
+		if (_rxFramer.busy()) {
+			if ((micros()-_rxFramer.ts_lastByte) > _timing.t_usRxFrame) {	// timeout -> error: no complete answer from the radio
+																														// (unexpected break of transmission)
+				logNewEntry(_rxFramer.rxBuffer,CIV_trRX, CIV_NO_MSG);
+				_rxFramer.reset();
+				CIVresultL.retVal = CIV_NO_MSG;
+				statsCount(_stats.rxRetVal[CIV_NO_MSG]);
+			}
+			else
+				CIVresultL.retVal = CIV_MSG_PENDING;					// frame not complete yet -> continue next time
+		}
+		else
+			CIVresultL.retVal = CIV_NO_MSG;									// nothing received
+
+  #endif
+
+} // receive
+
+//:::::::::
+template <class Transport>
+CIVresult_t CIVbus<Transport>::writeMsg (const uint8_t deviceAddr, const uint8_t cmd_body[], const uint8_t cmd_data[], const writeMode_t mode) {
+
+// this is the main function to write data to a specific radio
+// write a command from the MASTER(this is me) to a radio
+// return: info about success (CIV_OK, CIV_OK_DAV, CIV_NOK, or CIV_BUS_BUSY, CIV_HW_FAULT, CIV_BUS_CONFLICT,)
+// output: answer from the radio in rxBuffer (if mode == CIV_wAck)
+//
+// processing time: approx.  18ms if answer from radio is read and processed (ack)
+//                  approx. 105ms if no answer from radio
+//
+//                  approx.   5ms without ack from the radio
+//                  approx.  10ms when bus is shortcut
+
+
+	uint8_t attempts;
+	unsigned long ts_start = micros();
+
+  uint8_t txBufferL[CIV_TXBUFFERSIZE];
+  const uint8_t *txBuffer;
+
+
+  CIVresult_t CIVresultL;
+
+  CIVresultL.retVal     	= CIV_OK;
+
+	CIVresultL.address			= deviceAddr;
+	CIVresultL.cmd[0]				= (cmd_body[0]<sizeof(CIVresultL.cmd))       ? cmd_body[0] : sizeof(CIVresultL.cmd)-1;
+	memcpy(&CIVresultL.cmd[1], &cmd_body[1], CIVresultL.cmd[0]);             // command body into CIVresultL
+	CIVresultL.datafield[0] = (cmd_data[0]<sizeof(CIVresultL.datafield)) ? cmd_data[0] : sizeof(CIVresultL.datafield)-1;
+	memcpy(&CIVresultL.datafield[1], &cmd_data[1], CIVresultL.datafield[0]); // data part into CIVresultL
+
+  CIVresultL.value        = 0;										// value will NOT! be set in writeMsg
+
+  //............. get the complete command (prebuilt in the cache or built in txBufferL)
+
+  txBuffer = cachedMsg(deviceAddr, cmd_body, cmd_data);
+  if (txBuffer==NULL) {
+    if (!buildMsg(txBufferL, CIV_TXBUFFERSIZE, deviceAddr, cmd_body, cmd_data)) {
+      CIVresultL.retVal = CIV_NOK;								// command too long -> nothing is sent
+      statsCount(_stats.txRetVal[CIVresultL.retVal]);
+      return CIVresultL;
+    }
+    txBuffer = txBufferL;
+  }
+
+
+	//.............	let's get access to the CIV bus and write the command (again, in case of a collision)
+
+  attempts = 0;
+  do {
+    if (attempts>0) txWait(txBackoff(attempts));		// retransmission -> wait a random time
+    attempts++;
+    CIVresultL.retVal = CIV_OK;
+    sendMsg(txBuffer, mode, CIVresultL);
+  } while (txRetry(CIVresultL.retVal, attempts));
+
+	if (CIVresultL.retVal==CIV_OK) expectAnswer(deviceAddr, 0);	// on the bus -> the device will answer
+	statsCount(_stats.txRetVal[CIVresultL.retVal]);
+	statsTime(_stats.txTime, micros()-ts_start);
+	return CIVresultL;
+
+} // writeCmd
+
+//:::::::::
+template <class Transport>
+void CIVbus<Transport>::sendMsg(const uint8_t txBuffer[], const writeMode_t mode, CIVresult_t &CIVresultL) {
+
+// one attempt of writeMsg: get access to the CIV bus, write the frame and check the echo (if mode == CIV_wChk)
+// output: CIVresultL.retVal
+
+	uint16_t waitCounter;
+	uint16_t maxWait = echoLoops(txBuffer[0]);
+
+	waitCounter = 0;
+	while (canFetch() &&														// static buffer not full -> store a cmd, if available
+				 (waitCounter<_timing.t_readMsg)) {
+		if (fetchMsg()!=CIV_MSG_PENDING) break;				// store the new result into the buffer
+		waitCounter++; delayMicroseconds(t_usLoop);	// a frame is just coming in -> wait for the rest of it
+	}
+	// still data to be read or a command of writeMsgAsync is still on the bus -> give up!
+  if (busBusy() || (_txActive!=NULL)) {
+ 	  CIVresultL.retVal=CIV_BUS_BUSY; 					// CIV bus is not available -> break
+    logNewEntry(txBuffer,CIV_trTXbusy, CIVresultL.retVal);
+    return;
+ 	}
+
+  if (mode==CIV_wOn) wakeup();											// wakeup radio requested !
+
+	_transport.write(&txBuffer[1], txBuffer[0]);			// the complete frame at once
+
+  if (mode==CIV_wChk) {
+
+    _transport.flushOutput(); // wait, until the message really has been sent - this takes approx 5ms
+
+	  //............. read the own command back, and check, whether the bytes were sent correctly
+	  // there must be the complete command exactly as sent available in the rxBuffer
+
+    if (_rxRing!=NULL) {checkEcho(txBuffer, CIVresultL); return;}	// the echo is collected in the background
+
+    // (the receiver is idle at this point, so its buffer can be used for the echo)
+    uint8_t *rxBuffer = _rxFramer.rxBuffer;
+
+    rxBuffer[0]=0; waitCounter = 0;
+    while ((rxBuffer[0]< txBuffer[0]) && (waitCounter<maxWait)) {
+      waitCounter++; delayMicroseconds (t_usLoop);
+      if (_transport.available()>0) {
+        rxBuffer[0]++; rxBuffer[rxBuffer[0]] = _transport.read();
+  		  // even if only one byte hasn't been sent correctly, the whole command is corrupted
+        if (rxBuffer[rxBuffer[0]]!=txBuffer[rxBuffer[0]]) CIVresultL.retVal = CIV_BUS_CONFLICT;
+      }
+    }
+
+    if (waitCounter>=maxWait)            // CIV bus is shortcut -> break
+			{CIVresultL.retVal = CIV_HW_FAULT; logNewEntry(rxBuffer,CIV_trTXshort,CIVresultL.retVal); return;}
+		else
+			if (CIVresultL.retVal==CIV_BUS_CONFLICT)  			// CIV bus conflict -> break
+				{txJam(&rxBuffer[1], rxBuffer[0]); logNewEntry(rxBuffer,CIV_trTXconflict,CIVresultL.retVal); return;}
+
+  } //(mode==CIV_wChk)
+
+  logNewEntry(txBuffer,CIV_trTXok,CIVresultL.retVal);
+
+} // sendMsg
+
+//:::::::::
+template <class Transport>
+void CIVbus<Transport>::txService() {
+
+// send the oldest queued command (if the bus is free) and supervise the echo of the command on the bus
+
+	CIVtxSlot_t *slot = NULL;
+
+	if (_txActive!=NULL) {														// still waiting for the echo
+		if (!rxUnread() &&															// (the echo may be waiting in the interface, if read late)
+				((micros()-_txActive->ts_sent) > (t_usTurnaround + _txActive->txBuffer[0]*_timing.t_usByte))) {
+			logNewEntry(_txActive->txBuffer,CIV_trTXshort,CIV_HW_FAULT);	// no echo -> CIV bus is shortcut
+			txDone(*_txActive, CIV_HW_FAULT);
+		}
+		else return;
+	}
+
+	slot = txNext();																	// highest priority, oldest command
+	if (slot==NULL) return;														// nothing to do (or all in the backoff)
+
+	if (busBusy()) return;														// bus not free -> try again next time
+
+  if (slot->mode==CIV_wOn) wakeup();								// wakeup radio requested !
+
+	_transport.write(&slot->txBuffer[1], slot->txBuffer[0]);	// the complete frame at once
+	if (slot->attempts==0) {													// queueing latency of its class
+		CIVtxLatency_t &latency = _txLatency[slot->prio];
+		unsigned long waited = micros()-slot->ts_queued;
+		latency.count++; latency.sum += waited;
+		if (waited>latency.max) latency.max = waited;
+	}
+	slot->attempts++;
+
+	if (slot->mode==CIV_wChk) {												// check the echo byte by byte
+		slot->state		= CIV_txEcho;
+		slot->echoIdx	= 0;
+		slot->ts_sent	= micros();
+		_txActive			= slot;
+	}
+	else {
+	  logNewEntry(slot->txBuffer,CIV_trTXok,CIV_OK);
+		txDone(*slot, CIV_OK);
+	}
+
+}
+
+
+#endif
@@ -0,0 +1,269 @@
+/*
+	CIVcapture.cpp - Library for communication via ICOM's CI-V bus
+	Released into the public domain
+
+	Capture of the bus traffic into a file and read back (see CIVcapture.h)
+*/
+
+#if !defined(ARDUINO)
+
+#include <string.h>
+#include <chrono>
+
+#include "CIVmaster.h"
+
+#ifdef useHost
+
+//------------------------------------------------------------------------
+// little endian numbers in the files
+
+static void putU64(uint8_t buf[], uint64_t value) {
+	for (uint8_t idx=0; idx<8; idx++) {buf[idx] = uint8_t(value); value >>= 8;}
+}
+
+static uint64_t getU64(const uint8_t buf[]) {
+	uint64_t value = 0;
+	for (uint8_t idx=8; idx>0; idx--) value = (value<<8) | buf[idx-1];
+	return value;
+}
+
+static uint64_t steadyUs() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+//------------------------------------------------------------------------
+// class CIVcapture
+
+//ctor = constructor
+CIVcapture::CIVcapture() : _file(NULL), _index(NULL), _start(0), _offset(0), _records(0), _blockRecords(0)
+{
+}
+
+CIVcapture::~CIVcapture() {
+	close();
+}
+
+//:::::::::
+bool CIVcapture::open(const char path[]) {
+
+	uint8_t hdr[CIVcapHdrLen] = {'C','I','V','c','a','p',CIVcapVersion,0};
+	char idxPath[256];
+
+	close();
+	snprintf(idxPath, sizeof(idxPath), "%s.idx", path);
+	_file  = fopen(path, "wb");
+	_index = fopen(idxPath, "wb");
+	if ((_file==NULL) || (_index==NULL)) {close(); return false;}
+
+	putU64(&hdr[8], std::chrono::duration_cast<std::chrono::microseconds>(
+										std::chrono::system_clock::now().time_since_epoch()).count());
+	fwrite(hdr, 1, CIVcapHdrLen, _file);
+
+	_start = steadyUs();
+	_offset = CIVcapHdrLen;
+	_records = 0;
+	_blockRecords = 0;
+	return true;
+
+}
+
+//:::::::::
+void CIVcapture::close() {
+
+	if (_blockRecords>0) closeBlock();
+	if (_file!=NULL)	{fclose(_file);  _file = NULL;}
+	if (_index!=NULL)	{fclose(_index); _index = NULL;}
+
+}
+
+//:::::::::
+void CIVcapture::add(const CIVtraceEvt_t evt, const uint8_t retVal, const uint8_t frame[]) {
+
+	uint8_t hdr[CIVcapRecHdrLen];
+	uint64_t ts;
+
+	if (_file==NULL) return;
+
+	ts = steadyUs()-_start;
+	if (_blockRecords==0) {															// first record of a new block
+		_block.ts = ts;
+		_block.offset = _offset;
+		memset(_block.addrMap, 0, sizeof(_block.addrMap));
+	}
+	if (frame[0]>=4) _block.addrMap[frame[4]>>3] |= (1<<(frame[4]&7));	// source address
+
+	hdr[0] = frame[0];
+	putU64(&hdr[1], ts);
+	hdr[9] = evt;
+	hdr[10] = retVal;
+	fwrite(hdr, 1, CIVcapRecHdrLen, _file);
+	fwrite(&frame[1], 1, frame[0], _file);
+
+	_offset += CIVcapRecHdrLen + frame[0];
+	_records++;
+	if (++_blockRecords>=CIVcapBlockSize) closeBlock();
+
+}
+
+//:::::::::
+void CIVcapture::flush() {
+
+	if (_file!=NULL)	fflush(_file);
+	if (_index!=NULL)	fflush(_index);
+
+}
+
+//:::::::::
+void CIVcapture::closeBlock() {
+
+	uint8_t entry[CIVcapIdxLen];
+
+	putU64(&entry[0], _block.ts);
+	putU64(&entry[8], _block.offset);
+	memcpy(&entry[16], _block.addrMap, sizeof(_block.addrMap));
+	fwrite(entry, 1, CIVcapIdxLen, _index);
+	_blockRecords = 0;
+
+}
+
+
+//------------------------------------------------------------------------
+// class CIVcaptureReader
+
+//ctor = constructor
+CIVcaptureReader::CIVcaptureReader() : _file(NULL), _startTime(0), _block(0), _blockRecords(0), _addr(CIV_ADDR_NONE)
+{
+}
+
+CIVcaptureReader::~CIVcaptureReader() {
+	close();
+}
+
+//:::::::::
+bool CIVcaptureReader::open(const char path[]) {
+
+	uint8_t hdr[CIVcapHdrLen];
+	uint8_t entry[CIVcapIdxLen];
+	char idxPath[256];
+	FILE *index;
+	CIVcapIdx_t idx;
+
+	close();
+	_file = fopen(path, "rb");
+	if (_file==NULL) return false;
+	if ((fread(hdr, 1, CIVcapHdrLen, _file)!=CIVcapHdrLen) || (memcmp(hdr, "CIVcap", 6)!=0) ||
+			(hdr[6]!=CIVcapVersion)) {
+		close(); return false;
+	}
+	_startTime = getU64(&hdr[8]);
+
+	snprintf(idxPath, sizeof(idxPath), "%s.idx", path);
+	index = fopen(idxPath, "rb");													// no index -> sequential only
+	if (index!=NULL) {
+		while (fread(entry, 1, CIVcapIdxLen, index)==CIVcapIdxLen) {
+			idx.ts = getU64(&entry[0]);
+			idx.offset = getU64(&entry[8]);
+			memcpy(idx.addrMap, &entry[16], sizeof(idx.addrMap));
+			_idx.push_back(idx);
+		}
+		fclose(index);
+	}
+
+	_block = 0;
+	_blockRecords = 0;
+	return true;
+
+}
+
+//:::::::::
+void CIVcaptureReader::close() {
+
+	if (_file!=NULL) {fclose(_file); _file = NULL;}
+	_idx.clear();
+
+}
+
+//:::::::::
+void CIVcaptureReader::setAddrFilter(const uint8_t addr) {
+	_addr = addr;
+}
+
+//:::::::::
+bool CIVcaptureReader::seek(const uint64_t ts) {
+
+	size_t lo = 0, hi = _idx.size();
+	long pos;
+	CIVcapRec_t rec;
+	uint8_t frame[256];
+
+	if (_file==NULL) return false;
+
+	while (lo<hi) {																			// last block starting at/before ts
+		size_t mid = (lo+hi)/2;
+		if (_idx[mid].ts<=ts) lo = mid+1; else hi = mid;
+	}
+	if (lo>0)	seekBlock(lo-1);
+	else			seekBlock(0);
+
+	while (true) {																			// records before ts within the block
+		pos = ftell(_file);
+		uint16_t blockRecords = _blockRecords;
+		size_t block = _block;
+		if (!readRec(rec, frame)) return false;
+		if (rec.ts>=ts) {
+			fseek(_file, pos, SEEK_SET);
+			_blockRecords = blockRecords; _block = block;
+			return true;
+		}
+	}
+
+}
+
+//:::::::::
+bool CIVcaptureReader::next(CIVcapRec_t &rec, uint8_t frame[]) {
+
+	if (_file==NULL) return false;
+
+	while (true) {
+		// skip the blocks without the device (the end of a block is known by the start of the next one)
+		while ((_addr!=CIV_ADDR_NONE) && (_blockRecords==0) && (_block+1<_idx.size()) &&
+					 ((_idx[_block].addrMap[_addr>>3] & (1<<(_addr&7)))==0))
+			seekBlock(_block+1);
+
+		if (!readRec(rec, frame)) return false;
+		if ((_addr==CIV_ADDR_NONE) || ((rec.len>=4) && (frame[3]==_addr))) return true;
+	}
+
+}
+
+//:::::::::
+bool CIVcaptureReader::readRec(CIVcapRec_t &rec, uint8_t frame[]) {
+
+	uint8_t hdr[CIVcapRecHdrLen];
+
+	if (fread(hdr, 1, CIVcapRecHdrLen, _file)!=CIVcapRecHdrLen) return false;
+	rec.len			= hdr[0];
+	rec.ts			= getU64(&hdr[1]);
+	rec.evt			= CIVtraceEvt_t(hdr[9]);
+	rec.retVal	= hdr[10];
+	if (fread(frame, 1, rec.len, _file)!=rec.len) return false;	// incomplete record at the end
+
+	if (++_blockRecords>=CIVcapBlockSize) {_block++; _blockRecords = 0;}
+	return true;
+
+}
+
+//:::::::::
+void CIVcaptureReader::seekBlock(const size_t block) {
+
+	_block = block;
+	_blockRecords = 0;
+	fseek(_file, (block<_idx.size()) ? long(_idx[block].offset) : long(CIVcapHdrLen), SEEK_SET);
+
+}
+
+#endif
+
+#endif
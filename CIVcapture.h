@@ -0,0 +1,122 @@
+/*
+	CIVcapture.h - Library for communication via ICOM's CI-V bus
+	Released into the public domain
+
+	Capture of the bus traffic into a file and read back (Linux host only), e.g. for reproducible tests
+	with real traffic of the radios (replay by CIVreplayTransport).
+
+	capture file (append-only):
+		header:	"CIVcap" | version (1 byte) | 0 | start of the capture [us since 1970] (8 bytes)
+		record:	length of the frame (n) | time [us since the start] (8 bytes) | event (CIVtraceEvt_t) | retVal
+						| the frame (n bytes)
+	index file (<capture file>.idx): one entry per block of CIVcapBlockSize records
+		time of the first record (8 bytes) | offset of the first record (8 bytes) | bitmap of the source
+		addresses within the block (32 bytes)
+	All numbers little endian. The index allows to find a point in time (binary search) and to skip the
+	blocks without a specific device, without reading the whole capture.
+
+	e.g.
+		CIVcapture cap;
+		cap.open("ic7300.civcap");
+		civ.setCapture(&cap);								// from now on, every frame (RX and TX) is recorded
+
+	This file will be included by CIVmaster.h automatically.
+*/
+#ifndef CIVcapture_h
+#define CIVcapture_h
+
+#ifdef useHost
+
+#include <stdio.h>
+#include <vector>
+
+constexpr uint8_t		CIVcapVersion		= 1;
+constexpr uint8_t		CIVcapHdrLen		= 16;						// header of the file
+constexpr uint8_t		CIVcapRecHdrLen	= 11;						// record without the frame
+constexpr uint8_t		CIVcapIdxLen		= 48;						// entry of the index
+constexpr uint16_t	CIVcapBlockSize	= 256;					// records per index entry
+
+// one record of the capture
+typedef struct {
+	uint64_t				ts;													// [us] since the start of the capture
+	CIVtraceEvt_t		evt;
+	uint8_t					retVal;
+	uint8_t					len;												// length of the frame
+} CIVcapRec_t;
+
+// entry of the index
+typedef struct {
+	uint64_t				ts;													// time of the first record of the block
+	uint64_t				offset;											// position of the first record in the capture file
+	uint8_t					addrMap[32];								// source addresses within the block (1 bit per address)
+} CIVcapIdx_t;
+
+
+// recording
+class CIVcapture {
+
+public:
+
+	CIVcapture();
+	~CIVcapture();
+
+	bool		open(const char path[]);						// a new capture (an existing file is overwritten)
+	void		close();														// completes the index
+	bool		isOpen()																{return _file!=NULL;}
+
+	void		add(const CIVtraceEvt_t evt, const uint8_t retVal, const uint8_t frame[]);	// frame[0]: length
+	void		flush();														// write the buffered records into the file
+
+	uint32_t	records()															{return _records;}
+
+private:
+
+	void		closeBlock();												// write the index entry of the current block
+
+	FILE						*_file;
+	FILE						*_index;
+	uint64_t				_start;											// steady clock at the start [us]
+	uint64_t				_offset;										// position of the next record
+	uint32_t				_records;
+	CIVcapIdx_t			_block;											// index entry of the current block
+	uint16_t				_blockRecords;
+
+}; // end class CIVcapture
+
+
+// read back
+class CIVcaptureReader {
+
+public:
+
+	CIVcaptureReader();
+	~CIVcaptureReader();
+
+	bool		open(const char path[]);						// the index is used, if available
+	void		close();
+
+	bool		seek(const uint64_t ts);						// first record at/after ts [us since the start]
+	void		setAddrFilter(const uint8_t addr);	// only frames from addr (CIV_ADDR_NONE: all frames)
+	bool		next(CIVcapRec_t &rec, uint8_t frame[]);	// frame: up to 255 bytes; false: end of the capture
+
+	uint64_t	startTime()														{return _startTime;}	// [us since 1970]
+	size_t		blocks()															{return _idx.size();}
+
+private:
+
+	bool		readRec(CIVcapRec_t &rec, uint8_t frame[]);
+	void		seekBlock(const size_t block);
+
+	FILE						*_file;
+	uint64_t				_startTime;
+	std::vector<CIVcapIdx_t>	_idx;
+	size_t					_block;											// current block (only if _idx is used)
+	uint16_t				_blockRecords;							// records read in the current block
+	uint8_t					_addr;
+
+}; // end class CIVcaptureReader
+
+#endif
+
+
+#endif
@@ -9,6 +9,7 @@
 #ifndef CIVcmds_h
 #define CIVcmds_h
 
+#include <stdint.h>
 
 // command "body" of the CIV commands currently in use
 
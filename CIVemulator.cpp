@@ -0,0 +1,379 @@
+/*
+	CIVemulator.cpp - Library for communication via ICOM's CI-V bus
+	Released into the public domain
+
+	Emulation of ICOM radios on a virtual bus (see CIVemulator.h)
+*/
+
+#if !defined(ARDUINO)
+
+#include "CIVcmds.h"
+#include "CIVmaster.h"
+#include "CIVemulator.h"
+
+#ifdef useHost
+
+//------------------------------------------------------------------------
+// class CIVemuRadio
+
+//ctor = constructor
+CIVemuRadio::CIVemuRadio(const radioType_t type, const uint8_t addr, const CIVemuConfig_t &config) :
+	_type(type), _addr(addr), _config(config), _power(RADIO_ON), _ts_bootDone(0), _bootTo(CIV_ADDR_MASTER),
+	_ts_broadcast(micros()), _modMode(MOD_USB), _filter(FIL1), _dataMode(false), _rfPower(255)
+{
+	memset(&_counters, 0, sizeof(_counters));
+	_frequency = (type==TypeIC9700) ? 144174000 : 14074000;
+
+	if (type!=TypeIC7100) {																// clock of the radio
+		_settings[0x0094] = {4, 0x20,0x22,0x11,0x06};				// 2022-11-06
+		_settings[0x0095] = {2, 0x20,0x44};									// 20:44
+		_settings[0x0096] = {3, 0x01,0x00,0x00};						// +1h
+	}
+}
+
+//:::::::::
+CIVemuRadio &CIVemuRadio::setPower(const bool on) {
+
+	_power = on ? RADIO_ON : RADIO_OFF;
+	_ts_broadcast = micros();
+	return *this;
+
+}
+
+//:::::::::
+const uint8_t *CIVemuRadio::setting(const uint16_t item) {
+
+	std::map<uint16_t, std::vector<uint8_t>>::iterator it = _settings.find(item);
+
+	return (it!=_settings.end()) ? it->second.data() : NULL;
+
+}
+
+//:::::::::
+void CIVemuRadio::command(const uint8_t frame[], const uint8_t len, CIVemulator &bus) {
+
+// frame: FE FE dst src Cmd (Subcmd) (Data) FD
+
+	const uint8_t *body = &frame[4];
+	const uint8_t bodyLen = len-5;
+	const uint8_t src = frame[3];
+	uint8_t reply[CIV_TXBUFFERSIZE];
+	uint8_t replyLen = 0;
+	unsigned long delay = _config.t_usLatency;
+
+	_counters.commands++;
+	if (bodyLen==0) return;
+	if (_config.t_usJitter>0) delay += bus.random() % (_config.t_usJitter+1);
+
+	if (body[0]==CIV_C_TRX_ON_OFF[1]) {										// ON/OFF: also if the radio is off
+		if ((bodyLen==2) && (body[1]==CIV_D_ON[1]) && (_power==RADIO_OFF)) {
+			_power = RADIO_OFF_TR;														// booting, the OK comes afterwards
+			_ts_bootDone = micros() + 1000UL*(_config.t_msBoot>0 ? _config.t_msBoot : t_radio_OFF_TR[_type]);
+			_bootTo = src;
+			return;
+		}
+		if ((bodyLen==2) && (body[1]==CIV_D_OFF[1]) && (_power==RADIO_ON)) {
+			_power = RADIO_OFF;
+			reply[0] = C_OK;
+			bus.send(_addr, src, reply, 1, delay);
+			_counters.answers++;
+			return;
+		}
+	}
+
+	if (_power!=RADIO_ON) {_counters.ignored++; return;}		// off or booting -> no reaction at all
+
+	_counters.answers++;
+	if ((_config.nokPercent>0) && ((bus.random()%100) < _config.nokPercent)) {
+		_counters.noksInjected++;
+		reply[0] = C_NOK;
+		bus.send(_addr, src, reply, 1, delay);
+		return;
+	}
+
+	if (!answer(body, bodyLen, reply, replyLen)) {reply[0] = C_NOK; replyLen = 1;}
+	else if (replyLen==0)												 {reply[0] = C_OK;  replyLen = 1;}
+	bus.send(_addr, src, reply, replyLen, delay);
+
+}
+
+//:::::::::
+bool CIVemuRadio::answer(const uint8_t body[], const uint8_t len, uint8_t reply[], uint8_t &replyLen) {
+
+// answer to a command: data -> reply (Cmd (Subcmd) Data), replyLen = 0: OK; false: NOK
+
+	uint16_t item;
+
+	replyLen = 0;
+	switch (body[0]) {
+
+		case 0x03:																					// read operating frequency
+			if (len!=1) return false;
+			reply[0] = body[0];
+			CIVbcd::encode<unsigned long>(_frequency, &reply[1], 5, CIV_bcdLittleEndian);
+			replyLen = 6;
+			return true;
+
+		case 0x04:																					// read ModMode + filter
+			if (len!=1) return false;
+			reply[0] = body[0];
+			reply[1] = (_modMode==MOD_DV) ? 0x17 : _modMode;
+			reply[2] = _filter;
+			replyLen = 3;
+			return true;
+
+		case 0x05:																					// set frequency
+			if (len!=6) return false;
+			_frequency = CIVbcd::decode<unsigned long>(&body[1], 5, CIV_bcdLittleEndian);
+			return true;
+
+		case 0x06:																					// set ModMode (+ filter)
+			if ((len<2) || (len>3)) return false;
+			_modMode = (body[1]==0x17) ? MOD_DV : radioModMode_t(body[1]);
+			if (len==3) _filter = radioFilter_t(body[2]);
+			return true;
+
+		case 0x07:																					// VFO mode / select VFO
+		case 0x08:																					// memory mode / select channel
+			return true;
+
+		case 0x14:																					// levels
+			if (len<2) return false;
+			if ((body[1]==CIV_C_RF_POW[2]) && (len==2)) {			// read RF power
+				reply[0] = body[0]; reply[1] = body[1];
+				CIVbcd::encode<uint16_t>(_rfPower, &reply[2], 2, CIV_bcdBigEndian);
+				replyLen = 4;
+				return true;
+			}
+			if ((body[1]==CIV_C_RF_POW[2]) && (len==4))
+				_rfPower = uint8_t(CIVbcd::decode<uint16_t>(&body[2], 2, CIV_bcdBigEndian));
+			return (len>2);
+
+		case 0x16:																					// functions (filter, comp, NR ...)
+			if (len<2) return false;
+			if (len==2) {reply[0] = body[0]; reply[1] = body[1]; reply[2] = 0; replyLen = 3;}
+			return true;
+
+		case 0x18:																					// ON/OFF, already in this state
+			return (len==2);
+
+		case 0x19:																					// ID query
+			if ((len!=2) || (body[1]!=CIV_C_TRX_ID[2])) return false;
+			reply[0] = body[0]; reply[1] = body[1]; reply[2] = _addr;
+			replyLen = 3;
+			return true;
+
+		case 0x1A:																					// settings (incl. date/time)
+			if ((len<4) || (body[1]!=0x05)) return false;
+			item = (uint16_t(body[2])<<8) | body[3];
+			if (len>4) {																			// set
+				if (len-4 > CIV_TXBUFFERSIZE-8) return false;
+				std::vector<uint8_t> &value = _settings[item];
+				value.assign(1, len-4);
+				value.insert(value.end(), &body[4], &body[len]);
+				return true;
+			}
+			if (setting(item)==NULL) return false;						// read
+			memcpy(reply, body, 4);
+			memcpy(&reply[4], &_settings[item][1], _settings[item][0]);
+			replyLen = 4 + _settings[item][0];
+			return true;
+
+		case 0x1C:																					// TX state
+			if ((len<2) || (body[1]!=CIV_C_TX[2])) return false;
+			if (len==2) {reply[0] = body[0]; reply[1] = body[1]; reply[2] = 0; replyLen = 3;}
+			return true;
+
+		case 0x26:																					// ModMode of the selected VFO
+			if ((_type==TypeIC7100) || (len<2)) return false;
+			if (len==2) {
+				reply[0] = body[0]; reply[1] = body[1];
+				reply[2] = (_modMode==MOD_DV) ? 0x17 : _modMode; reply[3] = _dataMode; reply[4] = _filter;
+				replyLen = 5;
+				return true;
+			}
+			if (len!=5) return false;
+			_modMode	= (body[2]==0x17) ? MOD_DV : radioModMode_t(body[2]);
+			_dataMode	= (body[3]!=0);
+			_filter		= radioFilter_t(body[4]);
+			return true;
+
+	}
+	return false;
+
+}
+
+//:::::::::
+void CIVemuRadio::timer(CIVemulator &bus) {
+
+	uint8_t msg[7];
+	unsigned long now = micros();
+
+	if ((_power==RADIO_OFF_TR) && (long(now-_ts_bootDone)>=0)) {	// boot finished
+		_power = RADIO_ON;
+		_ts_broadcast = now;
+		msg[0] = C_OK;
+		bus.send(_addr, _bootTo, msg, 1, 0);
+		_counters.answers++;
+	}
+
+	if ((_power!=RADIO_ON) || (_config.t_msBroadcast==0) || (long(now-_ts_broadcast)<0)) return;
+
+	_ts_broadcast += 1000UL*_config.t_msBroadcast;
+	if (long(now-_ts_broadcast)>=0) _ts_broadcast = now + 1000UL*_config.t_msBroadcast;	// too late -> no burst
+
+	_frequency += 10;																			// the VFO is turned
+	msg[0] = CIV_C_F_SEND[1];
+	CIVbcd::encode<unsigned long>(_frequency, &msg[1], 5, CIV_bcdLittleEndian);
+	bus.send(_addr, CIV_ADDR_ALL, msg, 6, 0);
+	_counters.broadcasts++;
+
+	if ((_counters.broadcasts%10)==0) {
+		msg[0] = CIV_C_MOD_SEND[1];
+		msg[1] = (_modMode==MOD_DV) ? 0x17 : _modMode;
+		msg[2] = _filter;
+		bus.send(_addr, CIV_ADDR_ALL, msg, 3, 0);
+		_counters.broadcasts++;
+	}
+
+}
+
+
+//------------------------------------------------------------------------
+// class CIVemulator
+
+//ctor = constructor
+CIVemulator::CIVemulator(CIVmemTransport &bus) : _bus(bus), _rnd(0x2545F491)
+{
+}
+
+CIVemulator::~CIVemulator() {
+	stop();
+}
+
+//:::::::::
+uint8_t CIVemulator::defaultAddr(const radioType_t type) {
+
+	switch (type) {
+		case TypeIC7100:	return CIV_ADDR_7100;
+		case TypeIC7300:	return CIV_ADDR_7300;
+		case TypeIC9700:	return CIV_ADDR_9700;
+		case TypeIC705:		return CIV_ADDR_705;
+		default:					return CIV_ADDR_NONE;
+	}
+
+}
+
+//:::::::::
+CIVemuRadio &CIVemulator::addRadio(const radioType_t type, const uint8_t addr, const CIVemuConfig_t &config) {
+
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	_radios.emplace_back(type, (addr==CIV_ADDR_NONE) ? defaultAddr(type) : addr, config);
+	return _radios.back();
+
+}
+
+//:::::::::
+CIVemuRadio *CIVemulator::radio(const uint8_t addr) {
+
+	for (CIVemuRadio &radio : _radios) {
+		if (radio._addr==addr) return &radio;
+	}
+	return NULL;
+
+}
+
+//:::::::::
+void CIVemulator::service() {
+
+// the bytes sent by CIV are split into frames (a wakeup preamble of several C_START is skipped),
+// the frames are handed over to the radio addressed; then the answers which are due are fed in
+
+	uint8_t buf[CIVrxChunkSize];
+	size_t len, idx;
+	uint8_t inByte;
+	CIVemuRadio *dst;
+
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	while ((len = _bus.fetch(buf, sizeof(buf)))>0) {
+		for (idx=0; idx<len; idx++) {
+			inByte = buf[idx];
+			if (inByte==C_START) {
+				if (_rxFrame.size()<2)			_rxFrame.push_back(C_START);	// start bytes
+				else if (_rxFrame.size()>2)	_rxFrame.assign(1, C_START);	// erroneous start byte -> new frame
+				continue;																							// (FE FE FE ...: wakeup preamble)
+			}
+			if (_rxFrame.size()<2) {_rxFrame.clear(); continue;}		// no start bytes -> noise
+			_rxFrame.push_back(inByte);
+			if (inByte!=C_STOP) {
+				if (_rxFrame.size()>=CIV_BUFFERSIZE) _rxFrame.clear();	// too long -> discard
+				continue;
+			}
+			if ((_rxFrame.size()>=6) && ((dst = radio(_rxFrame[2]))!=NULL))
+				dst->command(_rxFrame.data(), uint8_t(_rxFrame.size()), *this);
+			_rxFrame.clear();
+		}
+	}
+
+	for (CIVemuRadio &radio : _radios) radio.timer(*this);
+
+	unsigned long now = micros();
+	while (!_pending.empty() && (long(now-_pending.front().ts_due)>=0)) {
+		_bus.feed(_pending.front().frame.data(), _pending.front().frame.size());
+		_pending.pop_front();
+	}
+
+}
+
+//:::::::::
+void CIVemulator::start() {
+
+	if (_run) return;
+	_run = true;
+	_thread = std::thread([this]() {
+		while (_run) {service(); delayMicroseconds(100);}
+	});
+
+}
+
+//:::::::::
+void CIVemulator::stop() {
+
+	_run = false;
+	if (_thread.joinable()) _thread.join();
+
+}
+
+//:::::::::
+void CIVemulator::send(const uint8_t addr, const uint8_t dst, const uint8_t body[], const uint8_t len,
+											 const unsigned long delay) {
+
+	pending_t frame;
+	std::deque<pending_t>::iterator pos;
+
+	frame.ts_due = micros() + delay;
+	frame.frame.reserve(len+5);
+	frame.frame.push_back(C_START); frame.frame.push_back(C_START);
+	frame.frame.push_back(dst); frame.frame.push_back(addr);
+	frame.frame.insert(frame.frame.end(), body, &body[len]);
+	frame.frame.push_back(C_STOP);
+
+	pos = _pending.end();																	// behind all frames due earlier or at the same time
+	while ((pos!=_pending.begin()) && (long((pos-1)->ts_due-frame.ts_due)>0)) pos--;
+	_pending.insert(pos, frame);
+
+}
+
+//:::::::::
+uint32_t CIVemulator::random() {
+
+	_rnd ^= _rnd<<13; _rnd ^= _rnd>>17; _rnd ^= _rnd<<5;		// xorshift32
+	return _rnd;
+
+}
+
+#endif
+
+#endif
@@ -0,0 +1,161 @@
+/*
+	CIVemulator.h - Library for communication via ICOM's CI-V bus
+	Released into the public domain
+
+	Emulation of ICOM radios on a virtual bus (Linux host only), e.g. for load tests of readMsg and
+	ICradio with several radios, without any real radio.
+
+	The emulator plays the "other side" of a CIVmemTransport: it takes the frames sent by CIV (fetch),
+	lets the addressed radio answer after its response time and feeds the answers back (feed).
+	Each radio answers
+		CIV_C_F_READ, CIV_C_MOD_READ, CIV_C_TRX_ID, CIV_C_TRX_ON_OFF, CIV_C_TX,
+		the commands of the mode sequences of CIVcmds.h (0x06, 0x07, 0x08, 0x14, 0x16, 0x1A 0x05, 0x26)
+		incl. date/time (CIV_C_DATE, CIV_C_TIME, CIV_C_UTC),
+	all other commands with NOK. If switched off, a radio reacts on CIV_C_TRX_ON_OFF (ON) only and needs
+	its boot time until it answers (with OK).
+	With transceive broadcasts switched on, a radio sends its frequency (CIV_C_F_SEND) periodically and
+	every 10th time its ModMode (CIV_C_MOD_SEND) in addition, as if the VFO was turned.
+
+	e.g.
+		CIV civ;
+		CIVemulator emu(civ.transport());
+		emu.addRadio(TypeIC7300).setFrequency(14074000);
+		emu.addRadio(TypeIC705, CIV_ADDR_705, {2000, 1000, 4000, 5, 100});	// slow, 5% NOK, broadcasts
+		while (...) {emu.service(); ic7300.loopp(millis()); ...}		// or emu.start() (own thread)
+
+	Note: the emulator is not included by CIVmaster.h, it has to be included by the host program.
+*/
+#ifndef CIVemulator_h
+#define CIVemulator_h
+
+#ifndef ICradio_h
+#include "ICradio.h"
+#endif
+
+#ifdef useHost
+
+#include <vector>
+#include <deque>
+#include <map>
+
+// behaviour of an emulated radio
+typedef struct {
+	unsigned long	t_usLatency;							// response time [us] (from the end of the command)
+	unsigned long	t_usJitter;								// + random 0 .. t_usJitter [us]
+	unsigned long	t_msBoot;									// boot time after switching on [ms] (0: as in t_radio_OFF_TR)
+	uint8_t				nokPercent;								// probability of a NOK instead of the answer [%]
+	unsigned long	t_msBroadcast;						// period of the transceive broadcasts [ms] (0: no broadcasts)
+} CIVemuConfig_t;
+
+constexpr CIVemuConfig_t CIVemuDefault = {1000, 0, 0, 0, 0};
+
+// counters of an emulated radio
+typedef struct {
+	uint32_t			commands;									// commands received
+	uint32_t			answers;									// answers sent (incl. NOK)
+	uint32_t			noksInjected;							// NOKs instead of the correct answer (nokPercent)
+	uint32_t			broadcasts;								// transceive broadcasts sent
+	uint32_t			ignored;									// commands ignored (radio OFF or booting)
+} CIVemuCounters_t;
+
+
+class CIVemulator;
+
+// one emulated radio
+class CIVemuRadio {
+
+public:
+
+	CIVemuRadio(const radioType_t type, const uint8_t addr, const CIVemuConfig_t &config);
+
+	void		setConfig(const CIVemuConfig_t &config)	{_config = config;}
+	CIVemuRadio	&setPower(const bool on);						// immediately, without boot time
+	CIVemuRadio	&setFrequency(const unsigned long frequency)	{_frequency = frequency; return *this;}
+	CIVemuRadio	&setModMode(const radioModMode_t modMode, const radioFilter_t filter)
+									{_modMode = modMode; _filter = filter; return *this;}
+
+	radioType_t			type()													{return _type;}
+	uint8_t					address()												{return _addr;}
+	radioOnOff_t		power()													{return _power;}	// RADIO_ON, RADIO_OFF or RADIO_OFF_TR
+	unsigned long		frequency()											{return _frequency;}
+	radioModMode_t	modMode()												{return _modMode;}
+	radioFilter_t		filter()												{return _filter;}
+	bool						dataMode()											{return _dataMode;}
+	const uint8_t		*setting(const uint16_t item);	// value of a 0x1A 0x05 setting ([0]: length), NULL if unknown
+	const CIVemuCounters_t &counters()							{return _counters;}
+
+private:
+
+	friend class CIVemulator;
+
+	void		command(const uint8_t frame[], const uint8_t len, CIVemulator &bus);	// frame: FE FE .. FD
+	void		timer(CIVemulator &bus);						// boot time and broadcasts
+	bool		answer(const uint8_t body[], const uint8_t len, uint8_t reply[], uint8_t &replyLen);	// false: NOK
+
+	radioType_t			_type;
+	uint8_t					_addr;
+	CIVemuConfig_t	_config;
+	CIVemuCounters_t	_counters;
+
+	radioOnOff_t		_power;
+	unsigned long		_ts_bootDone;							// [us]
+	uint8_t					_bootTo;									// address of the master, which switched the radio on
+	unsigned long		_ts_broadcast;						// time of the next broadcast [us]
+	unsigned long		_frequency;
+	radioModMode_t	_modMode;
+	radioFilter_t		_filter;
+	bool						_dataMode;
+	uint8_t					_rfPower;
+	std::map<uint16_t, std::vector<uint8_t>>	_settings;	// 0x1A 0x05 item -> value
+
+}; // end class CIVemuRadio
+
+
+// the virtual bus with the emulated radios
+class CIVemulator {
+
+public:
+
+	CIVemulator(CIVmemTransport &bus);
+	~CIVemulator();
+
+	CIVemuRadio	&addRadio(const radioType_t type, const uint8_t addr = CIV_ADDR_NONE,	// NONE: default of the type
+												const CIVemuConfig_t &config = CIVemuDefault);
+	CIVemuRadio	*radio(const uint8_t addr);					// NULL, if there's no radio with this address
+	size_t	radios()																{return _radios.size();}
+	void		setSeed(const uint32_t seed)						{_rnd = (seed!=0) ? seed : 1;}	// random (jitter, NOK)
+
+	void		service();													// process the commands, send the answers which are due
+	void		start();														// service() in a thread of its own
+	void		stop();
+
+	static uint8_t	defaultAddr(const radioType_t type);
+
+private:
+
+	friend class CIVemuRadio;
+
+	void		send(const uint8_t addr, const uint8_t dst, const uint8_t body[], const uint8_t len,
+							 const unsigned long delay);				// queue a frame of a radio
+	uint32_t	random();
+
+	typedef struct {
+		unsigned long					ts_due;							// [us]
+		std::vector<uint8_t>	frame;
+	} pending_t;
+
+	CIVmemTransport				&_bus;
+	std::deque<CIVemuRadio>	_radios;								// (deque: references stay valid)
+	std::deque<pending_t>	_pending;									// sorted by ts_due
+	std::vector<uint8_t>	_rxFrame;									// frame of CIV, being collected
+	uint32_t							_rnd;
+	std::mutex						_mutex;
+	std::thread						_thread;
+	std::atomic<bool>			_run {false};
+
+}; // end class CIVemulator
+
+#endif
+
+
+#endif
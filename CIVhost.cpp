@@ -0,0 +1,71 @@
+/*
+	CIVhost.cpp - Library for communication via ICOM's CI-V bus
+	Released into the public domain
+
+	Minimum set of the Arduino environment for a Linux host (see CIVhost.h)
+*/
+
+#if !defined(ARDUINO)
+
+#include <stdio.h>
+#include <chrono>
+#include <thread>
+
+#include "CIVmaster.h"
+
+#ifdef useHost
+
+CIVhostPrint Serial;
+
+static const std::chrono::steady_clock::time_point ts_start = std::chrono::steady_clock::now();
+
+//------------------------------------------------------------------------
+// time functions
+
+unsigned long micros() {
+	return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>
+		(std::chrono::steady_clock::now()-ts_start).count();
+}
+
+unsigned long millis() {
+	return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>
+		(std::chrono::steady_clock::now()-ts_start).count();
+}
+
+void delayMicroseconds(unsigned int us) {
+	std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+void delay(unsigned long ms) {
+	std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+
+//------------------------------------------------------------------------
+// class CIVhostPrint
+
+void CIVhostPrint::print(const char str[])			{fputs(str,stdout);}
+void CIVhostPrint::print(const String &str)			{fputs(str.c_str(),stdout);}
+void CIVhostPrint::print(char ch)								{fputc(ch,stdout);}
+void CIVhostPrint::print(int val, int base)			{print(long(val),base);}
+void CIVhostPrint::print(unsigned int val, int base)	{print((unsigned long)val,base);}
+
+void CIVhostPrint::print(long val, int base) {
+	if (val<0) {print('-'); val = -val;}
+	print((unsigned long)val,base);
+}
+
+void CIVhostPrint::print(unsigned long val, int base) {
+	char str[8*sizeof(unsigned long)+1];
+	char *pntr = &str[sizeof(str)-1];
+
+	*pntr = '\0';
+	do {
+		*--pntr = "0123456789ABCDEF"[val % base];
+		val /= base;
+	} while (val>0);
+	fputs(pntr,stdout);
+}
+#endif // useHost
+
+#endif // !ARDUINO
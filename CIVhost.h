@@ -0,0 +1,66 @@
+/*
+	CIVhost.h - Library for communication via ICOM's CI-V bus
+	Released into the public domain
+
+	Minimum set of the Arduino environment, which is needed in order to compile and run
+	CIVmaster on a Linux host (i.e. without an Arduino core).
+	This file will be included by CIVmaster.h automatically, if "useHost" is defined.
+
+	The interfaces to the bus (in-memory loopback, tty/pty) are in CIVtransport.h
+*/
+#ifndef CIVhost_h
+#define CIVhost_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <string>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+
+typedef uint8_t byte;
+
+#define HEX 16
+#define DEC 10
+#define BIN  2
+
+// time functions (based on the start of the program)
+unsigned long micros();
+unsigned long millis();
+void delayMicroseconds(unsigned int us);
+void delay(unsigned long ms);
+
+// Arduino String (used for the BT name only)
+class String : public std::string {
+public:
+	String() : std::string() {}
+	String(const char *str) : std::string(str) {}
+	String(const std::string &str) : std::string(str) {}
+};
+
+
+// output to stdout; replaces "Serial" (debug output, logDisplay ...)
+class CIVhostPrint {
+
+public:
+
+	void print(const char str[]);
+	void print(const String &str);
+	void print(char ch);
+	void print(int val, int base = DEC);
+	void print(unsigned int val, int base = DEC);
+	void print(long val, int base = DEC);
+	void print(unsigned long val, int base = DEC);
+
+	template <typename T> void println(T val) 						{print(val); print('\n');}
+	template <typename T> void println(T val, int base) 	{print(val, base); print('\n');}
+	void println() 																				{print('\n');}
+
+}; // end class CIVhostPrint
+
+extern CIVhostPrint Serial;
+
+
+#endif
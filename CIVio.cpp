@@ -0,0 +1,173 @@
+/*
+	CIVio.cpp - Library for communication via ICOM's CI-V bus
+	Released into the public domain
+
+	I/O task: the bus is served by a task of its own (see CIVio.h)
+*/
+
+#if defined(ARDUINO)
+	#include <Arduino.h>
+#endif
+
+#include "CIVmaster.h"
+
+#if defined(useHost) || defined(ESP32)
+
+//ctor = constructor
+CIVio::CIVio(CIVbase &bus) : _bus(bus)
+{
+}
+
+//------------------------------------------------------------------------
+// public member functions
+
+//::::::::: start the task
+#ifdef ESP32
+bool CIVio::start(const BaseType_t core) {
+
+	if (_run || _running) return false;
+
+	_run = true; _running = true;
+	if (xTaskCreatePinnedToCore(taskFunc, "CIVio", CIVioStackSize, this, CIVioPriority, &_task, core)!=pdPASS) {
+		_run = false; _running = false;
+		return false;
+	}
+	return true;
+
+}
+#else
+bool CIVio::start() {
+
+	if (_run || _running) return false;
+
+	_run = true; _running = true;
+	_thread = std::thread([this]() {run();});
+	return true;
+
+}
+#endif
+
+//::::::::: stop the task (the current pass is finished)
+void CIVio::stop() {
+
+	_run = false;
+#ifdef ESP32
+	while (_running) vTaskDelay(1);
+	_task = NULL;
+#else
+	if (_thread.joinable()) _thread.join();
+#endif
+
+}
+
+//::::::::: put a command into the command queue
+bool CIVio::submit(const uint8_t deviceAddr, const uint8_t cmd_body[], const uint8_t cmd_data[],
+									 const writeMode_t mode, const uint16_t tag, const unsigned long t_msWait) {
+
+	CIVioCmd_t cmd;
+
+	if ((cmd_body[0]>=sizeof(cmd.body)) || (cmd_data[0]>=sizeof(cmd.data))) {
+		_cmdsRejected++;
+		return false;
+	}
+
+	cmd.deviceAddr = deviceAddr;
+	cmd.mode = mode;
+	cmd.tag = tag;
+	memcpy(cmd.body, cmd_body, cmd_body[0]+1);
+	memcpy(cmd.data, cmd_data, cmd_data[0]+1);
+
+	if (!_cmdQueue.put(cmd, t_msWait)) {
+		_cmdsRejected++;
+		return false;
+	}
+	return true;
+
+}
+
+//::::::::: take the oldest entry out of the receive queue
+bool CIVio::receive(CIVioMsg_t &msg, const unsigned long t_msWait) {
+
+	return _rxQueue.get(msg, t_msWait);
+
+}
+
+//:::::::::
+CIVioCounters_t CIVio::counters() {
+
+	CIVioCounters_t counters;
+
+	counters.cmdsWritten	= _cmdsWritten;
+	counters.cmdsRejected	= _cmdsRejected;
+	counters.msgsReceived	= _msgsReceived;
+	counters.msgsDropped	= _msgsDropped;
+	counters.loops				= _loops;
+	return counters;
+
+}
+
+//------------------------------------------------------------------------
+// private methods
+
+//::::::::: the loop of the task
+void CIVio::run() {
+
+	while (_run) {
+		_loops++;
+		if (!service()) {											// nothing to do -> give the other tasks a chance
+#ifdef ESP32
+			vTaskDelay((t_usIoIdle/1000/portTICK_PERIOD_MS>0) ? t_usIoIdle/1000/portTICK_PERIOD_MS : 1);
+#else
+			delayMicroseconds(t_usIoIdle);
+#endif
+		}
+	}
+
+	_running = false;
+
+}
+
+#ifdef ESP32
+void CIVio::taskFunc(void *param) {
+
+	static_cast<CIVio *>(param)->run();
+	vTaskDelete(NULL);
+
+}
+#endif
+
+//::::::::: one pass of the task: receive everything available, then write one command
+bool CIVio::service() {
+
+	CIVioMsg_t	msg;
+	CIVioCmd_t	cmd;
+	bool				done = false;
+
+	// frames received
+	msg.tag = 0;
+	do {
+		msg.result = _bus.readMsgRaw();
+		if (msg.result.retVal<=CIV_NOK) {
+			_msgsReceived++;
+			if (!_rxQueue.put(msg)) _msgsDropped++;	// the application is too slow -> the newest one is lost
+			done = true;
+		}
+	} while (msg.result.retVal<=CIV_NOK);
+
+	// one command per pass, so the answers of the previous one are forwarded in between
+	if (_cmdQueue.get(cmd)) {
+		msg.result = _bus.writeMsg(cmd.deviceAddr, cmd.body, cmd.data, cmd.mode);
+		_cmdsWritten++;
+		if (cmd.tag!=0) {
+			msg.tag = cmd.tag;
+			msg.result.address = cmd.deviceAddr;
+			if (!_rxQueue.put(msg)) _msgsDropped++;
+		}
+		done = true;
+	}
+
+	return done;
+
+}
+
+#endif
@@ -0,0 +1,197 @@
+/*
+	CIVio.h - Library for communication via ICOM's CI-V bus
+	Released into the public domain
+
+	Optional I/O task (ESP32 and Linux host): a task of its own owns the bus, the application
+	submits the commands and receives the frames via two bounded queues.
+	So neither the blocking of the receiver nor the echo wait of writeMsg add to the latency of loop():
+		ESP32:				a FreeRTOS task, pinned to one core (by default the one, which is NOT running loop())
+		Linux host:		a std::thread (e.g. for load tests with many producer threads)
+
+	The task does in a loop:
+		- write the commands of the command queue (writeMsg, i.e. incl. the echo check),
+			the result is reported into the receive queue, if the command has got a tag
+		- readMsgRaw, every frame received (CIV_OK, CIV_OK_DAV, CIV_NOK) is put into the receive queue
+		- wait for t_usIoIdle, if there was nothing to do
+
+	e.g.
+		CIVio io(civ);
+		civ.setupp(); civ.registerAddr(CIV_ADDR_7300);	// configure the bus before start()
+		io.start();
+		io.submit(CIV_ADDR_7300, CIV_C_F_READ, CIV_D_NIX);		// false: command queue full
+		CIVioMsg_t msg;
+		while (io.receive(msg)) {...}												// no waiting by default
+
+	Note: as long as the task is running, the bus belongs to the task, i.e. the application must not
+	call the methods of civ (readMsg, writeMsg ...) or ICradio on the same bus; statsSnapshot and the
+	trace are fine after stop().
+
+	This file will be included by CIVmaster.h automatically.
+*/
+#ifndef CIVio_h
+#define CIVio_h
+
+#if defined(useHost) || defined(ESP32)
+
+#ifdef ESP32
+	#include "freertos/FreeRTOS.h"
+	#include "freertos/task.h"
+	#include "freertos/queue.h"
+#else
+	#include <chrono>
+#endif
+
+// sizes of the queues [entries]
+constexpr uint8_t  CIVioCmdQueueSize = 8;
+constexpr uint8_t  CIVioRxQueueSize  = 16;
+constexpr uint8_t  CIVioDataSize     = CIV_TXBUFFERSIZE-9;	// cmd_data incl. length byte (FE FE to fm Cmd(4) .. FD)
+
+constexpr unsigned long t_usIoIdle = 1000;				// waiting time of the task, if there was nothing to do [us]
+
+#ifdef ESP32
+	#ifndef ARDUINO_RUNNING_CORE
+		#define ARDUINO_RUNNING_CORE 1
+	#endif
+	constexpr uint32_t		CIVioStackSize = 4096;				// [bytes]
+	constexpr UBaseType_t	CIVioPriority  = 2;						// above loop() (1)
+	constexpr BaseType_t	CIVioCore = (portNUM_PROCESSORS>1) ? 1-ARDUINO_RUNNING_CORE : 0;	// the other core
+#endif
+
+// command for the I/O task
+typedef struct {
+	uint8_t				deviceAddr;
+	writeMode_t		mode;
+	uint16_t			tag;												// != 0: the result of writeMsg is reported (CIVioMsg_t)
+	uint8_t				body[5];										// as cmd_body of writeMsg ([0]: length)
+	uint8_t				data[CIVioDataSize];				// as cmd_data of writeMsg ([0]: length)
+} CIVioCmd_t;
+
+// entry of the receive queue
+typedef struct {
+	uint16_t			tag;												// 0: frame received; else: tag of the command written
+	CIVresult_t		result;											// as readMsgRaw resp. writeMsg (result.address: deviceAddr)
+} CIVioMsg_t;
+
+// counters of the I/O task
+typedef struct {
+	uint32_t			cmdsWritten;
+	uint32_t			cmdsRejected;								// submit failed (queue full, command too long)
+	uint32_t			msgsReceived;
+	uint32_t			msgsDropped;								// receive queue full
+	uint32_t			loops;
+} CIVioCounters_t;
+
+
+// bounded queue, which can be used by several threads/tasks at the same time
+template <class T, uint8_t Size>
+class CIVioQueue {
+
+public:
+
+#ifdef ESP32
+	CIVioQueue()													{_queue = xQueueCreateStatic(Size, sizeof(T), _storage, &_queueBuf);}
+
+	bool		put(const T &item, const unsigned long t_msWait = 0)
+		{return xQueueSend(_queue, &item, pdMS_TO_TICKS(t_msWait))==pdTRUE;}
+	bool		get(T &item, const unsigned long t_msWait = 0)
+		{return xQueueReceive(_queue, &item, pdMS_TO_TICKS(t_msWait))==pdTRUE;}
+	uint8_t	count()																{return uint8_t(uxQueueMessagesWaiting(_queue));}
+#else
+	bool		put(const T &item, const unsigned long t_msWait = 0) {
+		std::unique_lock<std::mutex> lock(_mutex);
+		if (!_notFull.wait_for(lock, std::chrono::milliseconds(t_msWait), [this]() {return _count<Size;})) return false;
+		_items[(_head+_count)%Size] = item; _count++;
+		_notEmpty.notify_one();
+		return true;
+	}
+	bool		get(T &item, const unsigned long t_msWait = 0) {
+		std::unique_lock<std::mutex> lock(_mutex);
+		if (!_notEmpty.wait_for(lock, std::chrono::milliseconds(t_msWait), [this]() {return _count>0;})) return false;
+		item = _items[_head]; _head = (_head+1)%Size; _count--;
+		_notFull.notify_one();
+		return true;
+	}
+	uint8_t	count()																{std::lock_guard<std::mutex> lock(_mutex); return _count;}
+#endif
+
+private:
+
+#ifdef ESP32
+	QueueHandle_t						_queue;
+	StaticQueue_t						_queueBuf;
+	uint8_t									_storage[Size*sizeof(T)];
+#else
+	T												_items[Size];
+	uint8_t									_head = 0;
+	uint8_t									_count = 0;
+	std::mutex							_mutex;
+	std::condition_variable	_notEmpty;
+	std::condition_variable	_notFull;
+#endif
+
+}; // end class CIVioQueue
+
+
+class CIVio {
+
+public:
+
+	CIVio(CIVbase &bus);
+	~CIVio()																{stop();}
+
+	//::::::::::::: start/stop the task
+#ifdef ESP32
+	bool		start(const BaseType_t core = CIVioCore);
+#else
+	bool		start();
+#endif
+	void		stop();															// waits until the task has finished
+	bool		running()															{return _running;}
+
+	//::::::::::::: application side (can be called by several tasks/threads)
+	bool		submit(const uint8_t deviceAddr, const uint8_t cmd_body[], const uint8_t cmd_data[],
+								 const writeMode_t mode = CIV_wChk, const uint16_t tag = 0, const unsigned long t_msWait = 0);
+	/*
+	the command is copied into the command queue, i.e. cmd_body/cmd_data may be changed afterwards.
+	Returns false, if the queue is still full after t_msWait [ms] or the command is too long.
+	*/
+
+	bool		receive(CIVioMsg_t &msg, const unsigned long t_msWait = 0);	// false: nothing within t_msWait [ms]
+
+	uint8_t	cmdsQueued()													{return _cmdQueue.count();}
+	uint8_t	msgsQueued()													{return _rxQueue.count();}
+	CIVioCounters_t counters();										// (not consistent as a whole while running)
+
+	CIVbase	&bus()																{return _bus;}
+
+private:
+
+	void		run();															// the loop of the task
+	bool		service();													// one pass; false: nothing to do
+#ifdef ESP32
+	static void taskFunc(void *param);
+#endif
+
+	CIVbase									&_bus;
+	CIVioQueue<CIVioCmd_t, CIVioCmdQueueSize>	_cmdQueue;
+	CIVioQueue<CIVioMsg_t, CIVioRxQueueSize>	_rxQueue;
+	std::atomic<uint32_t>		_cmdsWritten {0};
+	std::atomic<uint32_t>		_cmdsRejected {0};
+	std::atomic<uint32_t>		_msgsReceived {0};
+	std::atomic<uint32_t>		_msgsDropped {0};
+	std::atomic<uint32_t>		_loops {0};
+
+	std::atomic<bool>				_run {false};
+	std::atomic<bool>				_running {false};
+#ifdef ESP32
+	TaskHandle_t						_task = NULL;
+#else
+	std::thread							_thread;
+#endif
+
+}; // end class CIVio
+
+#endif
+
+
+#endif
@@ -5,204 +5,473 @@
 */
 
 
-#include <Arduino.h>
+#if defined(ARDUINO)
+	#include <Arduino.h>
+#endif
+
+#include <string.h>
 
 #include "CIVmaster.h"
 #include "CIVcmds.h"
 
-#if defined(useAltSoftSerial)
-	AltSoftSerial CIV_SERIAL;
-#elif defined(useSerial_1)
-	#define CIV_SERIAL Serial1
-#elif defined (useSerial_2)
-	#define CIV_SERIAL Serial2
-	BluetoothSerial CIV_BTSER;
-#endif
 
+//------------------------------------------------------------------------
+// class CIVframer
+
+//ctor = constructor
+CIVframer::CIVframer() : ownFrames(false), addrFilter(NULL)
+{
+	reset();
+}
+
+//::::::::: discard the bytes received so far
+void CIVframer::reset() {
+
+	state 			= CIV_idle;
+	rxBuffer[0]	= 0;
+	ts_lastByte = 0;
+
+}
+
+//::::::::: a frame has been started, but is not complete yet
+bool CIVframer::busy() {
+
+	return ((state==CIV_sync) || (state==CIV_collect));
+
+}
+
+//::::::::: process exactly one byte; returns true, if the frame is complete (stop byte received)
+bool CIVframer::collect(const uint8_t inByte) {
 
+	ts_lastByte = micros();
+	return step(inByte);
+
+}
+
+//::::::::: state machine of the receiver (one byte, without timestamp)
+bool CIVframer::step(const uint8_t inByte) {
+
+	switch (state) {
+
+		case CIV_stop:												// the previous frame has already been delivered
+		case CIV_idle:
+			if (inByte==C_START)					    	// first Startbyte
+				{rxBuffer[0]=1; rxBuffer[1]=inByte; state=CIV_sync;}
+			else
+				{rxBuffer[0]=0; state=CIV_idle;}
+		break;
+
+		case CIV_sync:
+			if (inByte==C_START)						    // second Startbyte
+				{rxBuffer[0]=2; rxBuffer[2]=inByte; state=CIV_collect;}
+			else
+				{rxBuffer[0]=0; state=CIV_idle;}
+		break;
+
+		case CIV_collect:										  // collect Data
+			if (inByte==C_START) {								// erroneous Startbyte: the next frame begins (e.g. after a
+				if (rxBuffer[0]>2)									// collision) -> resynchronise on it instead of losing it too
+					{rxBuffer[0]=1; state=CIV_sync;}
+				break;															// (FE FE FE ...: wakeup preamble)
+			}
+			if (rxBuffer[0]>=(CIV_BUFFERSIZE-1)) {			// frame too long for the buffer -> discard
+				rxBuffer[0]=0; state=CIV_idle;
+				break;
+			}
+			rxBuffer[0]++; rxBuffer[rxBuffer[0]]=inByte;
+			if (                                  // some plausibility checks ...
+					((rxBuffer[0]==3) && !ownFrames &&        // Target-Address wrong
+						!((inByte==CIV_ADDR_ALL)||(inByte==CIV_ADDR_MASTER)))
+					||
+					((rxBuffer[0]==4) && ownFrames &&         // Target-Address wrong and not sent by the master
+						!((rxBuffer[3]==CIV_ADDR_ALL)||(rxBuffer[3]==CIV_ADDR_MASTER)) &&
+						(inByte!=CIV_ADDR_MASTER))
+					||
+					((rxBuffer[0]==4) && (addrFilter!=NULL) &&	// Source-Address not registered
+						!(addrFilter[inByte>>3] & (1<<(inByte&7))) &&
+						!(ownFrames && (inByte==CIV_ADDR_MASTER)))
+				 )
+				state = CIV_idle;               // discard the received bytes, wait for Start byte
+
+			if (inByte == C_STOP)                 // Stop byte received -> end of message
+				state = CIV_stop;
+		break;
+
+	} // case state
+
+	return (state==CIV_stop);
+
+}
+
+
+//::::::::: process a number of bytes (bulk ingest, e.g. a chunk read from the interface at once)
+size_t CIVframer::collect(const uint8_t buf[], const size_t len) {
+
+// same result as collect(inByte) byte by byte, but stops after the first complete frame
+// (state==CIV_stop); returns the number of bytes consumed.
+// Instead of running through the state machine for every byte, the start bytes are searched by memchr
+// and the body of the frame is copied up to the next C_STOP (or erroneous C_START) in one go.
+
+	const uint8_t *pntr;
+	const uint8_t *pStart;
+	size_t idx = 0;
+	size_t span;
+
+	if (state==CIV_stop) state = CIV_idle;								// the previous frame has already been delivered
+
+	while ((idx<len) && (state!=CIV_stop)) {
+
+		if (state==CIV_idle) {															// skip everything up to the next start byte
+			pntr = (const uint8_t *)memchr(&buf[idx], C_START, len-idx);
+			if (pntr==NULL) {rxBuffer[0]=0; idx = len; break;}
+			idx = pntr-buf;
+		}
+
+		if ((state!=CIV_collect) || (rxBuffer[0]<4)) {			// start bytes and addresses: plausibility checks
+			step(buf[idx++]);
+			continue;
+		}
+
+		span = len-idx;																			// body: up to the end of the frame ...
+		if (span>(size_t)(CIV_BUFFERSIZE-1-rxBuffer[0])) span = CIV_BUFFERSIZE-1-rxBuffer[0];
+		if (span==0) {step(buf[idx++]); continue;}					// ... or up to the end of the buffer
+
+		pntr = (const uint8_t *)memchr(&buf[idx], C_STOP, span);
+		if (pntr!=NULL) span = pntr-&buf[idx]+1;
+		pStart = (const uint8_t *)memchr(&buf[idx], C_START, span);
+		if (pStart!=NULL) {																	// erroneous start byte -> the next frame begins
+			idx = pStart-buf;
+			step(buf[idx++]);
+			continue;
+		}
+		if (pntr!=NULL) state = CIV_stop;										// stop byte -> end of message
+
+		memcpy(&rxBuffer[rxBuffer[0]+1], &buf[idx], span);
+		rxBuffer[0] += span;
+		idx += span;
+
+	}
+
+	if (busy()) ts_lastByte = micros();										// (needed for the timeout of an incomplete frame only)
+	return idx;
+
+}
+
+
+//------------------------------------------------------------------------
+// class CIVrxRing
+
+// access to the indices of the ringbuffer (the counterpart's index needs acquire/release semantics)
+#ifdef CIV_ATOMIC_IDX
+	#define RING_LOAD(idx)					idx.load(std::memory_order_acquire)
+	#define RING_STORE(idx,val)			idx.store(val,std::memory_order_release)
+#else
+	#define RING_LOAD(idx)					(idx)
+	#define RING_STORE(idx,val)			(idx) = (val)
+#endif
 
 //ctor = constructor
-CIV::CIV()
+CIVrxRing::CIVrxRing() : _head(0), _tail(0), _busy(false), _ts_lastByte(0), _t_usRxFrame(t_usRxFrame),
+	_overruns(0), _filterOn(false)
 { uint8_t idx;
 
-	CIVresultBufIdx = 0; // CIVresultBuf is empty, "idx" points to first empty buffer element
-	for (idx=0;idx<knownAddrListSize;idx++)	// no valid address registered yet
-		knownAddress[idx] = CIV_ADDR_NONE;
-	
+	for (idx=0;idx<CIVrxRingSize;idx++)		// the echo of the own commands is needed for writeMsg
+		_frame[idx].ownFrames = true;
+	for (idx=0;idx<sizeof(_addrFilter);idx++)
+		RING_STORE(_addrFilter[idx],0);
+
 }
 
-//------------------------------------------------------------------------
-// public methods
+//::::::::: producer: push one byte
+void CIVrxRing::push(const uint8_t inByte) {
+	uint8_t head = RING_LOAD(_head);
 
+	if ((_frame[head].busy()) &&															// incomplete frame timed out -> discard
+			((micros()-_frame[head].ts_lastByte) > RING_LOAD(_t_usRxFrame)))
+		_frame[head].reset();
 
-//::::::::: initialize the HW /Interfaces
-void CIV::setupp(bool ESP_BT, String BTname) {
+	if (_frame[head].collect(inByte))													// frame complete
+		head = publish(head);
 
-#if defined(ESP32)
-	_ESP_BT = ESP_BT;
-	if (_ESP_BT) {												// initialize BT if required (ESP only)
-		CIV_BTSER.begin(BTname);
-	}	
-	else
-#endif
-	{
-		_ESP_BT = false;										// initialize Altsoftserial, Serial1 or Serial2
-		CIV_SERIAL.begin(CIV_BAUDRATE);
-		CIV_SERIAL.setTimeout(UART_TIMEOUT);
+	RING_STORE(_ts_lastByte,_frame[head].ts_lastByte);					// state of the receiver for the consumer
+	RING_STORE(_busy,_frame[head].busy());
+}
+
+//::::::::: producer: push a number of bytes
+void CIVrxRing::push(const uint8_t buf[], const size_t len) {
+	uint8_t head = RING_LOAD(_head);
+	size_t idx = 0;
+
+	if ((_frame[head].busy()) &&															// incomplete frame timed out -> discard
+			((micros()-_frame[head].ts_lastByte) > RING_LOAD(_t_usRxFrame)))
+		_frame[head].reset();
+
+	while (idx<len) {																					// bulk ingest, frame by frame
+		idx += _frame[head].collect(&buf[idx], len-idx);
+		if (_frame[head].state==CIV_stop)
+			head = publish(head);
 	}
 
+	RING_STORE(_ts_lastByte,_frame[head].ts_lastByte);					// state of the receiver for the consumer
+	RING_STORE(_busy,_frame[head].busy());
 }
 
-void CIV::setupp(bool ESP_BT) {
+//::::::::: frames from other source addresses are discarded by the producer already
+// (the filter is copied byte by byte, so it can be changed while the producer is running; a frame
+// received during the change may be filtered by the old or the new addresses)
+void CIVrxRing::setAddrFilter(const uint8_t *addrFilter) {
+	uint8_t idx;
 
-#if defined(ESP32)
-	_ESP_BT = ESP_BT;
-	if (_ESP_BT) {												// initialize BT if required (ESP only)
-		CIV_BTSER.begin(BT_NAME);
-	}	
-	else
+	if (addrFilter==NULL) {RING_STORE(_filterOn,false); return;}
+	for (idx=0;idx<sizeof(_addrFilter);idx++) RING_STORE(_addrFilter[idx],addrFilter[idx]);
+	RING_STORE(_filterOn,true);
+}
+
+//:::::::::
+void CIVrxRing::setFrameTimeout(const unsigned long t_us) {
+#ifndef CIV_ATOMIC_IDX
+	noInterrupts();																						// 32 bit value may be read by an ISR
+#endif
+	RING_STORE(_t_usRxFrame,t_us);
+#ifndef CIV_ATOMIC_IDX
+	interrupts();
+#endif
+}
+
+//::::::::: consumer: frames lost so far
+uint16_t CIVrxRing::overruns() {
+	uint16_t n;
+#ifndef CIV_ATOMIC_IDX
+	noInterrupts();																						// 16 bit value may be written by an ISR
 #endif
-	{
-		_ESP_BT = false;										// initialize Altsoftserial, Serial1 or Serial2
-		CIV_SERIAL.begin(CIV_BAUDRATE);
-		CIV_SERIAL.setTimeout(UART_TIMEOUT);
+	n = RING_LOAD(_overruns);
+#ifndef CIV_ATOMIC_IDX
+	interrupts();
+#endif
+	return n;
+}
+
+//::::::::: producer: source address of the frame registered ?
+bool CIVrxRing::accepted(const uint8_t frame[]) {
+	uint8_t src = frame[4];
+
+	if (!RING_LOAD(_filterOn) || (src==CIV_ADDR_MASTER)) return true;	// (the echo is needed for writeMsg)
+	return (RING_LOAD(_addrFilter[src>>3]) & (1<<(src&7)))!=0;
+}
+
+//::::::::: producer: hand over the completed frame in _frame[head] to the consumer; returns the new head
+uint8_t CIVrxRing::publish(const uint8_t head) {
+	uint8_t next = (head+1) & (CIVrxRingSize-1);
+
+	if (!accepted(_frame[head].rxBuffer)) {										// device not registered -> discard
+		_frame[head].reset();
+		return head;
+	}
+	if (next==RING_LOAD(_tail)) {															// ringbuffer full -> frame is lost
+		RING_STORE(_overruns,RING_LOAD(_overruns)+1);
+		_frame[head].reset();
+		return head;
 	}
+	RING_STORE(_head,next);																		// publish the frame to the consumer
+	return next;
+}
+
+//::::::::: a frame is currently being received
+bool CIVrxRing::busy() {
+	unsigned long ts_lastByte;
+
+	if (!RING_LOAD(_busy)) return false;
+
+#ifndef CIV_ATOMIC_IDX
+	noInterrupts();																						// 32 bit value may be changed by an ISR
+#endif
+	ts_lastByte = RING_LOAD(_ts_lastByte);
+#ifndef CIV_ATOMIC_IDX
+	interrupts();
+#endif
 
+	return ((micros()-ts_lastByte) <= RING_LOAD(_t_usRxFrame));
 }
 
-void CIV::setupp() {
+//::::::::: consumer: oldest completed frame
+const uint8_t *CIVrxRing::front() {
+	uint8_t tail = RING_LOAD(_tail);
 
-		_ESP_BT = false;										// initialize Altsoftserial, Serial1 or Serial2
-		CIV_SERIAL.begin(CIV_BAUDRATE);
-		CIV_SERIAL.setTimeout(UART_TIMEOUT);
+	if (tail==RING_LOAD(_head)) return NULL;										// nothing available
+	return _frame[tail].rxBuffer;
+}
+
+//::::::::: consumer: release the oldest completed frame
+void CIVrxRing::pop() {
+	uint8_t tail = RING_LOAD(_tail);
 
+	if (tail!=RING_LOAD(_head))
+		RING_STORE(_tail, (tail+1) & (CIVrxRingSize-1));
 }
 
-//::::::::::::: is a specific address known to CIV ?
-bool CIV::isAddrKnown(const uint8_t deviceAddr) {
-	uint8_t idx;
+//::::::::: consumer: number of completed frames
+uint8_t CIVrxRing::count() {
+	return (RING_LOAD(_head)-RING_LOAD(_tail)) & (CIVrxRingSize-1);
+}
+
+
+//------------------------------------------------------------------------
+// class CIVmsgRef
+
+const CIVresult_t CIVmsgRef::noMsg = {CIV_NO_MSG, CIV_ADDR_NONE, {0}, {0}, 0};
 
-//	Serial.print ("A:"); Serial.println (deviceAddr, HEX);
+
+//------------------------------------------------------------------------
+// class CIVbase
 
 
-	for (idx=0;idx < knownAddrListSize;idx++)
-		if (knownAddress[idx]==deviceAddr)	break;				// deviceAddr known ?
 
-///	Serial.print ("idx:");Serial.println (idx, HEX);
+//ctor = constructor
+CIVbase::CIVbase()
+{ uint8_t idx;
+
+	for (idx=0;idx<=CIVresultBufSize;idx++)	// CIVresultBuf is empty
+		CIVresultBuf[idx].state = CIV_slotFree;
+	for (idx=0;idx<CIVmailboxCount;idx++)	// no valid address registered yet
+		_mailbox[idx].address = CIV_ADDR_NONE;
+	memset(_addrMap,0,sizeof(_addrMap));
+#ifdef bigRamAv
+	memset(_addrMailbox,CIV_SLOT_NONE,sizeof(_addrMailbox));
+#endif
+	memset(_txLatency,0,sizeof(_txLatency));
 
-	if (idx < knownAddrListSize)	return true;					// deviceAddr known !
-	else													return false;
+	for (idx=0;idx<CIVtxQueueSize;idx++)		// queue of writeMsgAsync is empty
+		_txQueue[idx].state = CIV_txFree;
+	for (idx=0;idx<CIVtxCacheSize;idx++)		// cache of prebuilt frames is empty
+		_txCache[idx][0] = 0;
+	for (idx=0;idx<CIVreqTableSize;idx++)	// no request pending
+		_reqTable[idx].state = CIV_reqFree;
+	statsReset();														// (after the mailboxes)
 
+	setTiming(CIV_BAUDRATE);
+	
 }
 
+//------------------------------------------------------------------------
+// public methods
+
 
 //::::::::::::: make a specific CIV address known to CIV
-void	CIV::registerAddr(const uint8_t deviceAddr) {
+void	CIVbase::registerAddr(const uint8_t deviceAddr) {
 	uint8_t idx;
-	
-	if (!isAddrKnown(deviceAddr)) {											// deviceAddr not known yet -> add
-		for (idx=0;idx < knownAddrListSize;idx++) {			// search for empty space
-			if (knownAddress[idx]==CIV_ADDR_NONE)	break;	// empty space available
-		}
-		if (idx<knownAddrListSize)	knownAddress[idx]=deviceAddr;	// -> store
+
+	if (isAddrKnown(deviceAddr) || (deviceAddr==CIV_ADDR_NONE)) return;	// already known
+
+	for (idx=0;idx < CIVmailboxCount;idx++) {						// search for a free mailbox
+		if (_mailbox[idx].address==CIV_ADDR_NONE)	break;
 	}
+	if (idx>=CIVmailboxCount) return;										// no space left
+
+	_mailbox[idx].address = deviceAddr;								// -> store
+	_mailbox[idx].head		= CIV_SLOT_NONE;
+	_mailbox[idx].tail		= CIV_SLOT_NONE;
+	_mailbox[idx].count		= 0;
+	_mailbox[idx].dropped	= 0;
+	_hdrRuleCount[idx]		= 0;
+	memset(&_stats.device[idx],0,sizeof(CIVaddrStats_t));
+	_stats.device[idx].address = deviceAddr;
+#ifdef bigRamAv
+	_addrMailbox[deviceAddr] = idx;
+#endif
+	_addrMap[deviceAddr>>3] |= (1<<(deviceAddr&7));
+	_addrCount++;
 
-//	Serial.print(knownAddress[0],HEX);
-//	Serial.print(knownAddress[1],HEX);
-//	Serial.println(knownAddress[2],HEX);
+	_rxFramer.addrFilter = addrFilter();								// early rejection of the other devices
+	if (_rxRing!=NULL) _rxRing->setAddrFilter(addrFilter());
 
 }
 
 
 //::::::::::::: remove a specific CIV address from the known address list
-void	CIV::unregisterAddr(const uint8_t deviceAddr) {
+void	CIVbase::unregisterAddr(const uint8_t deviceAddr) {
+	CIVmailbox_t *mbx = mailbox(deviceAddr);
 	uint8_t idx;
 
-	for (idx=0;idx < knownAddrListSize;idx++)
-		if (knownAddress[idx]==deviceAddr)	break;				// deviceAddr known ?
-	if (idx<knownAddrListSize) {												// deviceAddr known -> remove
- 	 knownAddress[idx]=CIV_ADDR_NONE;
-	}
+	if (mbx==NULL) return;															// deviceAddr not known
 
-}
+	for (idx=mbx->head; idx!=CIV_SLOT_NONE; idx=CIVresultBuf[idx].next)	// messages not fetched are lost
+		CIVresultBuf[idx].state = CIV_slotFree;
+	_stored -= mbx->count;
 
-//::::::::: read data in a Multi Radio System (two or three devices connected to CI-V-bus)
-CIVresult_t CIV::readMsg(const uint8_t deviceAddr) {
+	mbx->address = CIV_ADDR_NONE;
+	_stats.device[mbx-_mailbox].address = CIV_ADDR_NONE;
+#ifdef bigRamAv
+	_addrMailbox[deviceAddr] = CIV_SLOT_NONE;
+#endif
+	_addrMap[deviceAddr>>3] &= ~(1<<(deviceAddr&7));
+	_addrCount--;
 
-  CIVresult_t CIVresultL;
-	uint8_t idx;
+	_rxFramer.addrFilter = addrFilter();
+	if (_rxRing!=NULL) _rxRing->setAddrFilter(addrFilter());
 
-	
-	// check and read buffer
-	for (idx=0;idx<CIVresultBufIdx;idx++) {						// first, check the buffer for a proper message
-		if (CIVresultBuf[idx].address==deviceAddr) {		// message from requested device found
+}
 
-			CIVresultL = CIVresultBuf[idx];								// get message from buffer
+//::::::::::::: mailbox of a registered device
+CIVmailbox_t *CIVbase::mailbox(const uint8_t deviceAddr) {
 
-			for ( ;(idx+1)<CIVresultBufIdx;idx++) {				// close the gap in the buffer list
-				CIVresultBuf[idx]=CIVresultBuf[idx+1];
-			}
-			if (CIVresultBufIdx>0) CIVresultBufIdx--;
-			
-			return CIVresultL;														// return result -> done for now
-		}
-	}
+	if (!isAddrKnown(deviceAddr)) return NULL;
+#ifdef bigRamAv
+	return &_mailbox[_addrMailbox[deviceAddr]];				// O(1)
+#else
+	uint8_t idx;																			// (only a few mailboxes)
+	for (idx=0;idx < CIVmailboxCount;idx++)
+		if (_mailbox[idx].address==deviceAddr) return &_mailbox[idx];
+	return NULL;
+#endif
 
-	// check and read HW-CIVBus (if possible)
-	if  (CIVresultBufIdx < CIVresultBufSize) {				// static buffer could store a new result, if required
-																										// i.e. "buffer not full"
-		CIVresultL = readMsgRaw();													// -> check the HW for a new message
+}
 
-		if (CIVresultL.retVal<=CIV_NOK) {								// valid message received, "CIV_NO_MSG" will be discarded
-			if (CIVresultL.address==deviceAddr) {					// got it - the correct device has answered
-				return CIVresultL;													// return result -> done for now
-			}
-			else {
-				if (isAddrKnown(deviceAddr)) {							// deviceAddr known ?!
-					CIVresultBuf[CIVresultBufIdx]=CIVresultL;	// store the new result into the buffer
-					CIVresultBufIdx++;												// points to the next empty element
-				}
-			}
-		}
+//::::::::: read data in a Multi Radio System (two or three devices connected to CI-V-bus)
+CIVmsgRef CIVbase::readMsgRef(const uint8_t deviceAddr) {
+
+	CIVmailbox_t *mbx = mailbox(deviceAddr);
+	CIVmsgSlot_t *slot;
+
+	// check the mailbox of the device: oldest message first
+	if ((mbx!=NULL) && (mbx->head!=CIV_SLOT_NONE)) {
+		slot = &CIVresultBuf[mbx->head];
+		mbx->head = slot->next;
+		if (mbx->head==CIV_SLOT_NONE) mbx->tail = CIV_SLOT_NONE;
+		mbx->count--; _stored--;
+		return CIVmsgRef(slot);													// message from requested device found
 	}
 
-	CIVresultL.retVal 		= CIV_NO_MSG;									// nothing valid received from the correct device
-	CIVresultL.address 	= CIV_ADDR_NONE;							// this may happen also in the case of "buffer full"
-	CIVresultL.cmd[0]=0;
-	CIVresultL.datafield[0]=0;
-	CIVresultL.value=0;
+	// check and read HW-CIVBus (if possible)
+	if (!canFetch()) return CIVmsgRef();							// "buffer full" -> nothing is read from the bus
+	slot = freeSlot();
+
+	receiveTimed(slot->result);												// -> check the HW for a new message, directly into the slot
+	if ((slot->result.retVal<=CIV_NOK) &&							// valid message received, "CIV_NO_MSG" will be discarded
+			(slot->result.address==deviceAddr))						// got it - the correct device has answered
+		return CIVmsgRef(slot);
 
-	return CIVresultL;																// return result
+	keepMsg(slot);																		// store it for the other device, if registered
+	return CIVmsgRef();																// nothing valid received from the correct device
 
 }
 
-  
-//::::::::: 
-CIVresult_t CIV::readMsgRaw() {
+//::::::::: same as readMsgRef, but returns a copy of the message
+CIVresult_t CIVbase::readMsg(const uint8_t deviceAddr) {
 
-// read the data (complete commands)coming in from every radio connected to the CIV Bus
-// return: info about success (CIV_OK, CIV_OK_DAV, CIV_NOK,CIV_NO_MSG)+Data eventually
-// output: answer from the radio in rxBuffer
+	CIVmsgRef msg = readMsgRef(deviceAddr);
 
-	uint8_t	inByte; 
-	uint16_t lpCounter = 0; 
-  CIV_State_t CIV_State;
+	return *msg;																			// the slot is released by ~CIVmsgRef
 
-  uint8_t idx;
-  uint8_t DstartIdx;
-  uint8_t DstopIdx;
-  unsigned long mul = 1;
+}
 
-// length of Cmd + Subcommands; 
-// default: 1; if the command is in this list: 2
-// 0x1A may have 4 bytes (if cmd is 0x1A+0x05). This has to be covered extra in source code, since this is
-// currently (Jan 2021) the only 4 byte command ...
+//:::::::::
+void CIVbase::readRing(CIVresult_t &CIVresultL) {
 
-//   constexpr uint8_t CIV_C_LENGTH_2[]  {0x07,0x0E,0x13,0x14,0x15,0x16,0x19,0x1A,0x1B,0x1C,0x1E,0x21,0x27};
-// table moved to CIVcmds.h !!! 
-	
-  CIVresult_t CIVresultL;
+// take the oldest frame of another device out of the receive ringbuffer
+// (echos of own commands are checked and dropped on the way)
+// output: as readMsgRaw
 
+	const uint8_t *frame;
 
   CIVresultL.retVal       = CIV_OK;
   CIVresultL.address      = CIV_ADDR_NONE;
@@ -210,69 +479,40 @@ CIVresult_t CIV::readMsgRaw() {
   CIVresultL.datafield[0] = 0;
   CIVresultL.value        = 0;
 
-  #ifdef debugWithoutRadio
+	while ((frame=_rxRing->front())!=NULL) {
+		if (frame[4]!=CIV_ADDR_MASTER) {				// take the oldest frame from the ringbuffer
+			decodeMsg(frame, CIVresultL);
+			_rxRing->pop();
+			return;
+		}
+		txEchoFrame(frame);											// echo of an own command -> check, if requested
+		_rxRing->pop();
+	}
+
+	if (_rxRing->busy()) 	CIVresultL.retVal = CIV_MSG_PENDING;
+	else									CIVresultL.retVal = CIV_NO_MSG;
 
-    uint8_t idx;
-    // various test patterns
-    constexpr uint8_t rxBufDummy[] = { 6,C_START,C_START,0xE0,0x94, C_OK,C_STOP};                           // OK
-//    constexpr uint8_t rxBufDummy[] = { 6,C_START,C_START,0xE0,0x94,C_NOK,C_STOP};                           // NOK
-//		constexpr uint8_t rxBufDummy[] = {11,C_START,C_START,0xE0,0x94,0x00,0x89,0x67,0x45,0x23,0x01,C_STOP};   // OK_DAV
+} // readRing
 
-		for (idx=0; idx<=rxBufDummy[0];idx++) rxBuffer[idx]=rxBufDummy[idx];
-  
-  #else
-		// quickcheck, whether something has been received
-		if (serAvailable()==0) {CIVresultL.retVal = CIV_NO_MSG; return CIVresultL;}
-
-		//.... receive the answer of the radio (exactly ONE message)
-
-		lpCounter=0;CIV_State=CIV_idle; // we start from scratch ...
-
-		while ((CIV_State!=CIV_stop) && (lpCounter<t_readMsg)) {
-
-      lpCounter++;delayMicroseconds(t_usLoop);
-
-			if (serAvailable()>0) {
-				inByte = serRead();
-				switch (CIV_State) {
-			
-					case CIV_idle:
-						if (inByte==C_START)					    	// first Startbyte
-							{rxBuffer[0]=1; rxBuffer[1]=inByte; CIV_State=CIV_sync;}
-            else
-							rxBuffer[0]=0;
-					break;
-
-					case CIV_sync:
-						if (inByte==C_START)						    // second Startbyte
-							{rxBuffer[0]=2; rxBuffer[2]=inByte; CIV_State=CIV_collect;}
-            else 
-							{rxBuffer[0]=0; CIV_State=CIV_idle;}
-					break;
-
-					case CIV_collect:										    // collect Data
-            rxBuffer[0]++; rxBuffer[rxBuffer[0]]=inByte;
-            if (                                  // some plausibility checks ...
-                ((rxBuffer[0]==3) &&                      // Target-Address wrong
-                  !((inByte==CIV_ADDR_ALL)||(inByte==CIV_ADDR_MASTER)))
-								||
-								(inByte==C_START)																			// erroneous Startbyte
-               ) 
-              CIV_State = CIV_idle;               // discard the received bytes, wait for Start byte              
-
-            if (inByte == C_STOP)                 // Stop byte received -> end of message
-              CIV_State = CIV_stop;               // leave the while loop ...
-					break;
-					case CIV_stop:
-					break;
-				} // case state
-			}	// if serAvailable
-		}	// while loop
-
-		if (lpCounter==t_readMsg) // timeout -> error: no complete answer from the radio(unexpected break of transmission)
-			{logNewEntry(rxBuffer,"RX", CIV_NO_MSG); CIVresultL.retVal = CIV_NO_MSG; return CIVresultL;}
-    
-  #endif
+
+//:::::::::
+void CIVbase::decodeMsg(const uint8_t rxBuffer[], CIVresult_t &CIVresultL) {
+
+// evaluation of a complete frame (FE FE .. FD) in rxBuffer
+// output: info about success (CIV_OK, CIV_OK_DAV, CIV_NOK)+Data eventually in CIVresultL
+// (CIVresultL is usually a slot of CIVresultBuf, i.e. the result is stored there directly)
+
+  uint8_t idx;
+  uint8_t DstartIdx;
+  uint8_t DstopIdx;
+
+// length of Cmd + Subcommands: see headerLength() and CIV_HDR_TABLE / CIV_HDR_RULES in CIVmaster.h
+
+  CIVresultL.retVal       = CIV_OK;
+  CIVresultL.address      = CIV_ADDR_NONE;
+  CIVresultL.cmd[0]       = 0;
+  CIVresultL.datafield[0] = 0;
+  CIVresultL.value        = 0;
 
   CIVresultL.address      = rxBuffer[4];                  // Source address
 
@@ -300,15 +540,11 @@ CIVresult_t CIV::readMsgRaw() {
     // 4 Byte cmd                                                              D-Start4 D-Stop=rxBuffer[0]-1
 
     // calculate the start of the datafield depending on command / subcommnd(s)
-    DstartIdx = 6;    // 1 byte command
-
-    if (rxBuffer[0] < DstartIdx) {CIVresultL.retVal=CIV_NOK; return CIVresultL;}  // no valid content in Buffer
+    DstartIdx = headerLength(rxBuffer);
+    if (DstartIdx > (sizeof(CIVresultL.cmd)-1)) DstartIdx = sizeof(CIVresultL.cmd)-1;	// (device specific rules)
+    DstartIdx += 5;
 
-    // if cmd is found in list -> 2 Byte command
-    for (idx=0; idx<sizeof(CIV_C_LENGTH_2); idx++) {if (rxBuffer[5]==CIV_C_LENGTH_2[idx]) DstartIdx = 7;}
-    if ((rxBuffer[5]==0x1A) && (rxBuffer[6]==0x05)) DstartIdx = 9;  // 4-Byte Command+Subcommand
-
-    if (rxBuffer[0] < DstartIdx) {CIVresultL.retVal=CIV_NOK; return CIVresultL;}  // no valid content in Buffer
+    if (rxBuffer[0] < DstartIdx) {CIVresultL.retVal=CIV_NOK; return;}  // no valid content in Buffer
 
     DstopIdx = rxBuffer[0]-1;
 
@@ -316,76 +552,143 @@ CIVresult_t CIV::readMsgRaw() {
       CIVresultL.cmd[idx-4]=rxBuffer[idx];
     CIVresultL.cmd[0] = DstartIdx-5;
 
+    if ((DstopIdx-DstartIdx+1) > (int)(sizeof(CIVresultL.datafield)-1))	// longer than the datafield (e.g. scope data)
+      DstopIdx = DstartIdx+sizeof(CIVresultL.datafield)-2;					// -> truncated
+
     for (idx = DstartIdx; idx <= DstopIdx; idx++)           // load datafield of result
       CIVresultL.datafield[idx-DstartIdx+1] = rxBuffer[idx];
     CIVresultL.datafield[0] = DstopIdx-DstartIdx+1;
 
-    mul = 1; CIVresultL.value = 0;                          // load value of result
-
-    if ((DstopIdx-DstartIdx)==0)  {                         // 1 byte data
-      CIVresultL.value = (unsigned long)rxBuffer[DstartIdx];
-    }
- 
-    if ((DstopIdx-DstartIdx)==1)  {                         // 2 byte data -> first byte is of highest order
-      for (idx = DstopIdx; idx >= DstartIdx; idx--) {
-        CIVresultL.value += (rxBuffer[idx] & 0x0f) * mul; mul *= 10;
-        CIVresultL.value += (rxBuffer[idx] >> 4) * mul; mul *= 10;
-      }
-    }
-  
-    if ((DstopIdx-DstartIdx) == 4){                         // 5 byte data -> first byte is of lowest order
-      for (idx = DstartIdx; idx <= DstopIdx; idx++) {
-        CIVresultL.value += (rxBuffer[idx] & 0x0f) * mul; mul *= 10;
-        CIVresultL.value += (rxBuffer[idx] >> 4) * mul; mul *= 10;
+    CIVresultL.value = 0;                                   // load value of result
+
+    switch (DstopIdx-DstartIdx+1) {
+      case 1:                                               // 1 byte data
+        CIVresultL.value = (unsigned long)rxBuffer[DstartIdx];
+        break;
+      case 2:                                               // 2 byte data -> first byte is of highest order
+        CIVresultL.value = CIVbcd::decode<unsigned long>(&rxBuffer[DstartIdx],2,CIV_bcdBigEndian);
+        break;
+      case 5:                                               // 5 byte data -> first byte is of lowest order
+        CIVresultL.value = CIVbcd::decode<unsigned long>(&rxBuffer[DstartIdx],5,CIV_bcdLittleEndian);
+        break;
+      case 6: {                                             // 6 byte frequency (> 4.29GHz: see CIVbcd::frequency)
+        uint64_t value = CIVbcd::decode(&rxBuffer[DstartIdx],6,CIV_bcdLittleEndian);
+        CIVresultL.value = (value>0xFFFFFFFFUL) ? 0xFFFFFFFFUL : (unsigned long)value;
+        break;
       }
     }
   
   } // data are available ...
 
-  logNewEntry(rxBuffer,"RX", CIVresultL.retVal);
-  
-  return CIVresultL;
+  reqMatch(CIVresultL, rxBuffer[3]);											// answer to a pending request ?
+  statsFrame(CIVresultL);
 
-} // readMsgRaw
+  logNewEntry(rxBuffer,CIV_trRX, CIVresultL.retVal);
 
+} // decodeMsg
 
 
-//::::::::: 
-CIVresult_t CIV::writeMsg (const uint8_t deviceAddr, const uint8_t cmd_body[], const uint8_t cmd_data[], const writeMode_t mode) {
 
-// this is the main function to write data to a specific radio
-// write a command from the MASTER(this is me) to a radio
-// return: info about success (CIV_OK, CIV_OK_DAV, CIV_NOK, or CIV_BUS_BUSY, CIV_HW_FAULT, CIV_BUS_CONFLICT,)
-// output: answer from the radio in rxBuffer (if mode == CIV_wAck)
-//
-// processing time: approx.  18ms if answer from radio is read and processed (ack)
-//                  approx. 105ms if no answer from radio
-//
-//                  approx.   5ms without ack from the radio
-//                  approx.  10ms when bus is shortcut
+//:::::::::
+uint8_t CIVbase::headerLength(const uint8_t rxBuffer[]) {
 
+// length of Cmd + Subcommands of the frame in rxBuffer (rxBuffer[5]: Cmd, rxBuffer[6]: first Subcommand)
+// usually one lookup in CIV_HDR_TABLE; multi level commands: one more in CIV_HDR_RULES
 
-	uint8_t idx; uint8_t waitCounter;
+	const uint8_t cmd = rxBuffer[5];
+	const uint8_t sub = rxBuffer[6];
+	CIVmailbox_t *mbx;
+	uint8_t idx, mbxIdx;
 
-  uint8_t txBuffer[CIV_TXBUFFERSIZE];
+	if ((mbx=mailbox(rxBuffer[4]))!=NULL) {							// device specific grammar
+		mbxIdx = mbx-_mailbox;
+		for (idx=0; idx<_hdrRuleCount[mbxIdx]; idx++) {
+			const CIVhdrRule_t &rule = _hdrRules[mbxIdx][idx];
+			if ((rule.cmd==cmd) && ((rule.sub==sub) || (rule.sub==CIV_SUB_ANY))) return rule.hdrLength;
+		}
+	}
 
+	switch ((CIV_HDR_TABLE[cmd>>2] >> ((cmd&3)<<1)) & 3) {
+		case CIV_HDR_2:		return 2;
+		case CIV_HDR_RULE:
+			for (idx=0; idx<sizeof(CIV_HDR_RULES)/sizeof(CIVhdrRule_t); idx++) {
+				if ((CIV_HDR_RULES[idx].cmd==cmd) &&
+						((CIV_HDR_RULES[idx].sub==sub) || (CIV_HDR_RULES[idx].sub==CIV_SUB_ANY)))
+					return CIV_HDR_RULES[idx].hdrLength;
+			}
+			return 2;
+		default:					return 1;
+	}
+
+}
+
+//:::::::::
+void CIVbase::setGrammar(const uint8_t deviceAddr, const CIVhdrRule_t rules[], const uint8_t count) {
+
+	CIVmailbox_t *mbx = mailbox(deviceAddr);
+
+	if (mbx==NULL) return;															// device not registered
+	_hdrRules[mbx-_mailbox]			= rules;
+	_hdrRuleCount[mbx-_mailbox]	= count;
+
+}
 
-  CIVresult_t CIVresultL;
+//:::::::::
+CIVresult_t CIVbase::checkEcho(const uint8_t txBuffer[], CIVresult_t &CIVresultL) {
 
-  CIVresultL.retVal     	= CIV_OK;
+// check the echo of the command just sent, in case a receive ringbuffer is in use:
+// the echo has been collected as a complete frame in the ringbuffer; frames of other devices which
+// are received in the meantime will be stored into CIVresultBuf (if possible)
 
-	CIVresultL.address			= deviceAddr;
-	CIVresultL.cmd[0] 			= 0;
-  for (idx=1; idx<=cmd_body[0];idx++) {           // command body into CIVresultL
-    CIVresultL.cmd[0]++; CIVresultL.cmd[CIVresultL.cmd[0]] = cmd_body[idx];}
+	const uint8_t *frame;
+	CIVmsgSlot_t *slot;
+	uint16_t waitCounter = 0;
+	uint16_t maxWait = echoLoops(txBuffer[0]);
+	uint8_t idx;
 
-	CIVresultL.datafield[0] = 0;
-  for (idx=1; idx<=cmd_data[0];idx++) {           // data part into CIVresultL
-    CIVresultL.datafield[0]++; CIVresultL.datafield[CIVresultL.datafield[0]] = cmd_data[idx];}
+	while (waitCounter<maxWait) {
+		waitCounter++; delayMicroseconds (t_usLoop);
+
+		while ((frame=_rxRing->front())!=NULL) {
+			if (frame[4]==CIV_ADDR_MASTER) {						// echo of the own command
+				// even if only one byte hasn't been sent correctly, the whole command is corrupted
+				for (idx=0; idx<=txBuffer[0]; idx++)
+					if (frame[idx]!=txBuffer[idx]) CIVresultL.retVal = CIV_BUS_CONFLICT;
+				if (CIVresultL.retVal==CIV_BUS_CONFLICT) {	// CIV bus conflict -> break
+					txJam(&frame[1], frame[0]);
+					logNewEntry(frame,CIV_trTXconflict,CIVresultL.retVal);
+				}
+				else
+					logNewEntry(txBuffer,CIV_trTXok,CIVresultL.retVal);
+				_rxRing->pop();
+				return CIVresultL;
+			}
+			if ((slot=freeSlot())!=NULL) {					// message of a radio -> store it, if possible
+				decodeMsg(frame, slot->result);
+				keepMsg(slot);
+			}
+			_rxRing->pop();
+		}
+	}
 
-  CIVresultL.value        = 0;										// value will NOT! be set in writeMsg
+	CIVresultL.retVal = CIV_HW_FAULT;										// no echo -> CIV bus is shortcut
+	logNewEntry(txBuffer,CIV_trTXshort,CIVresultL.retVal);
+	return CIVresultL;
 
-  //............. build the complete command and write to txBuffer
+} // checkEcho
+
+//:::::::::
+bool CIVbase::buildMsg(uint8_t txBuffer[], const uint8_t maxLength,
+									 const uint8_t deviceAddr, const uint8_t cmd_body[], const uint8_t cmd_data[]) {
+
+// build the complete command (frame) in txBuffer; txBuffer[0] is the length of the frame
+
+	uint8_t idx;
+
+	if ((cmd_body[0]+cmd_data[0]+5) >= maxLength) {	// frame doesn't fit into the buffer
+		txBuffer[0] = 0;
+		return false;
+	}
 
   txBuffer[1] = C_START;txBuffer[2] = C_START;		// preamble into buffer
   txBuffer[3] = deviceAddr;
@@ -400,213 +703,854 @@ CIVresult_t CIV::writeMsg (const uint8_t deviceAddr, const uint8_t cmd_body[], c
 
   txBuffer[0]++; txBuffer[txBuffer[0]] = C_STOP;  // postamble into buffer
 
+	return true;
+
+}
 
-	//.............	let's get access to the CIV bus and write the command
+//:::::::::
+const uint8_t *CIVbase::cachedMsg(const uint8_t deviceAddr, const uint8_t cmd_body[], const uint8_t cmd_data[]) {
 
-	if (CIVresultBufIdx < CIVresultBufSize)	{			// static buffer not full -> store a cmd, if available
-		CIVresultBuf[CIVresultBufIdx]=readMsgRaw();	// store the new result into the buffer
-		if ((isAddrKnown(CIVresultBuf[CIVresultBufIdx].address)) &&
-		    (CIVresultBuf[CIVresultBufIdx].retVal<=CIV_NOK))
-			CIVresultBufIdx++;												// points to the next empty element
+// complete frame of a command without data out of the cache; on a miss, the frame is built into the
+// oldest entry of the cache
+// the cache is searched by content (address + command), since the same command may be at different places
+// in memory (constexpr arrays of CIVcmds.h in different .cpp/.ino files) and vice versa
+
+	uint8_t idx, len;
+	uint8_t *frame;
+
+	if ((cmd_data[0]!=0) || (cmd_body[0]+6>=CIVtxCacheMsgSize)) return NULL;	// not to be cached
+
+	len = cmd_body[0]+5;
+	for (idx=0;idx<CIVtxCacheSize;idx++) {
+		frame = _txCache[idx];
+		if ((frame[0]==len) && (frame[3]==deviceAddr) && (memcmp(&frame[5],&cmd_body[1],cmd_body[0])==0))
+			return frame;
 	}
-  if (serAvailable()>0) {                 	// still data to be read -> give up!
- 	  CIVresultL.retVal=CIV_BUS_BUSY; 					// CIV bus is not available -> break
-    logNewEntry(txBuffer,"CHK", CIVresultL.retVal); 
-    return CIVresultL;
- 	}
 
-  if (mode==CIV_wOn) {														// wakeup radio requested !
-    for (idx=0; idx<40;idx++) serWrite(C_START); 	// wakeup radio: (40)*C_START
-  }
+	frame = _txCache[_txCacheNext];										// miss -> replace the oldest entry
+	_txCacheNext++; if (_txCacheNext>=CIVtxCacheSize) _txCacheNext = 0;
+	buildMsg(frame, CIVtxCacheMsgSize, deviceAddr, cmd_body, cmd_data);
+	return frame;
 
-	for (idx=1; idx<=txBuffer[0];idx++) {serWrite(txBuffer[idx]);}
+}
 
-  if (mode==CIV_wChk) {
+//:::::::::
+CIVmsgSlot_t *CIVbase::freeSlot() {
 
-    serflushOutput(); // wait, until the message really has been sent - this takes approx 5ms
+	uint8_t idx;
 
-	  //............. read the own command back, and check, whether the bytes were sent correctly
-	  // there must be the complete command exactly as sent available in the rxBuffer
+	for (idx=0;idx<=CIVresultBufSize;idx++)
+		if (CIVresultBuf[idx].state==CIV_slotFree) return &CIVresultBuf[idx];
+	return NULL;
 
-    rxBuffer[0]=0; waitCounter = 0;
-    while ((rxBuffer[0]< txBuffer[0]) && (waitCounter<t_sendCmd)) { 
-      waitCounter++; delayMicroseconds (t_usLoop);
-      if (serAvailable()>0) {
-        rxBuffer[0]++; rxBuffer[rxBuffer[0]] = serRead();
-  		  // even if only one byte hasn't been sent correctly, the whole command is corrupted
-        if (rxBuffer[rxBuffer[0]]!=txBuffer[rxBuffer[0]]) CIVresultL.retVal = CIV_BUS_CONFLICT;
-      }
-    }
+}
 
-    if (waitCounter>=t_sendCmd)            // CIV bus is shortcut -> break
-			{CIVresultL.retVal = CIV_HW_FAULT; logNewEntry(rxBuffer,"TX_S",CIVresultL.retVal); return CIVresultL;}
-		else
-			if (CIVresultL.retVal==CIV_BUS_CONFLICT)  			// CIV bus conflict -> break
-				{logNewEntry(rxBuffer,"TX_C",CIVresultL.retVal); return CIVresultL;}
+//:::::::::
+bool CIVbase::canFetch() {
 
-  } //(mode==CIV_wChk)
-  
-  logNewEntry(txBuffer,"TXok",CIVresultL.retVal);
+	if ((_ovfPolicy==CIV_ovfStall) && (_stored>=CIVresultBufSize)) return false;
+	return (freeSlot()!=NULL);													// (not all slots lent to CIVmsgRefs)
 
-	return CIVresultL;
+}
 
-} // writeCmd
+//:::::::::
+void CIVbase::keepMsg(CIVmsgSlot_t *slot) {
 
-//::::::::::::: logging
+// put the message just decoded into slot into the mailbox of its device (if registered; it stays there,
+// until it is fetched by readMsgRef/readMsg); otherwise the slot is free again.
+// If the device exceeds its quota or the buffer is full, messages are dropped according to _ovfPolicy.
 
-#ifdef log_CIV
-	uint8_t CIV::logEntry=0;
-	uint8_t CIV::logBuffer[logMaxEntries][logMsgLength];
-  uint8_t CIV::logBufferState[logMaxEntries];
-	char CIV::logBufferName[logMaxEntries][logNameLength];
-#endif
+	CIVmailbox_t *mbx;
+	CIVmailbox_t *hog;
+	uint8_t idx = slot-CIVresultBuf;
+	uint8_t prev, cur;
 
+	if ((slot->result.retVal>CIV_NOK) || ((mbx=mailbox(slot->result.address))==NULL)) {
+		slot->state = CIV_slotFree;
+		return;
+	}
 
-//.............
-void CIV::logClear() {
-  #ifdef log_CIV
-		uint8_t idx;
-		for (idx=0; idx<logMaxEntries-1;idx++) { // clear all buffer entries
-			logBuffer[idx][0]=0;
-			logBufferName[idx][0]='\0';
+	if ((_ovfPolicy==CIV_ovfCoalesce) &&								// replace an older message with the same command
+			(slot->result.retVal==CIV_OK_DAV) &&												// (data only, not the acks OK/NOK),
+			(((_ovfQuota>0) && (mbx->count>=_ovfQuota)) || (_stored>=CIVresultBufSize))) {	// if there's no room
+		for (prev=CIV_SLOT_NONE, cur=mbx->head; cur!=CIV_SLOT_NONE; prev=cur, cur=CIVresultBuf[cur].next) {
+			if (memcmp(CIVresultBuf[cur].result.cmd, slot->result.cmd, slot->result.cmd[0]+1)==0) {
+				dropMsg(mbx, prev);
+				_ovfCounters.coalesced++;
+				break;
+			}
 		}
-		logEntry = 0;
-  #endif
+	}
+
+	if ((_ovfQuota>0) && (mbx->count>=_ovfQuota)) {		// quota of the device exceeded
+		mbx->dropped++; _ovfCounters.droppedQuota++;
+		if (_ovfPolicy==CIV_ovfDropNewest) {slot->state = CIV_slotFree; return;}
+		dropMsg(mbx, CIV_SLOT_NONE);
+	}
+
+	if (_stored>=CIVresultBufSize) {										// buffer full
+		if ((_ovfPolicy==CIV_ovfDropNewest) || (_ovfPolicy==CIV_ovfStall)) {
+			mbx->dropped++; _ovfCounters.droppedNewest++;
+			slot->state = CIV_slotFree;
+			return;
+		}
+		hog = mbx;																				// -> the device with the most messages pays
+		for (cur=0; cur<CIVmailboxCount; cur++)
+			if ((_mailbox[cur].address!=CIV_ADDR_NONE) && (_mailbox[cur].count>hog->count)) hog = &_mailbox[cur];
+		if (hog->count>0) {
+			hog->dropped++; _ovfCounters.droppedOldest++;
+			dropMsg(hog, CIV_SLOT_NONE);
+		}
+	}
+
+	slot->state	= CIV_slotFull;
+	slot->next	= CIV_SLOT_NONE;
+	if (mbx->tail==CIV_SLOT_NONE)	mbx->head = idx;
+	else													CIVresultBuf[mbx->tail].next = idx;
+	mbx->tail = idx;
+	mbx->count++; _stored++;
+
 }
 
-//.............
-void CIV::logNewEntry(uint8_t msg[],const char name[], const uint8_t state) {
+//:::::::::
+void CIVbase::dropMsg(CIVmailbox_t *mbx, const uint8_t prev) {
 
-#ifdef log_CIV
-	
+// remove the message following prev (CIV_SLOT_NONE: the oldest one) from the mailbox and free its slot
+
+	uint8_t idx = (prev==CIV_SLOT_NONE) ? mbx->head : CIVresultBuf[prev].next;
+
+	if (idx==CIV_SLOT_NONE) return;
+
+	if (prev==CIV_SLOT_NONE)	mbx->head = CIVresultBuf[idx].next;
+	else											CIVresultBuf[prev].next = CIVresultBuf[idx].next;
+	if (mbx->tail==idx) mbx->tail = prev;
+
+	CIVresultBuf[idx].state = CIV_slotFree;
+	mbx->count--; _stored--;
+
+}
+
+//:::::::::
+void CIVbase::setRetryPolicy(const uint8_t maxAttempts, const unsigned long t_usMin, const unsigned long t_usMax) {
+
+	_retryMax			= (maxAttempts>0) ? maxAttempts : 1;
+	_retryMin			= (t_usMin>0) ? t_usMin : 1;
+	_retryMaxWait	= (t_usMax>_retryMin) ? t_usMax : _retryMin;
+	if (_rnd==0) _rnd = micros() ^ (uint32_t(CIV_ADDR_MASTER)<<16) ^ 0x9E3779B9UL;	// seed of the random generator
+	if (_rnd==0) _rnd = 1;
+
+}
+
+//:::::::::
+void CIVbase::setOverflowPolicy(const CIVoverflow_t policy, const uint8_t quota) {
+
+	_ovfPolicy	= policy;
+	_ovfQuota		= quota;
+
+}
+
+//:::::::::
+uint16_t CIVbase::droppedMsgs(const uint8_t deviceAddr) {
+
+	CIVmailbox_t *mbx = mailbox(deviceAddr);
+
+	return (mbx!=NULL) ? mbx->dropped : 0;
+
+}
+
+//:::::::::
+uint8_t CIVbase::fetchMsg() {
+
+// receive the next message (if any) and keep it for readMsg, if it's from a known device
+// return: retVal of the message (CIV_MSG_PENDING, if a frame is just coming in)
+// If all slots are in use, the message is lost (but the bus is read anyway, e.g. for the echo)
+
+	CIVmsgSlot_t *slot = freeSlot();
+	CIVresult_t CIVresultL;
+
+	if (slot==NULL) {receiveTimed(CIVresultL); return CIVresultL.retVal;}
+
+	receiveTimed(slot->result);
+	keepMsg(slot);
+	return slot->result.retVal;
+
+}
+
+
+//::::::::::::: asynchronous writing (queue)
+
+//:::::::::
+CIVtxHandle_t CIVbase::writeMsgAsync (const uint8_t deviceAddr, const uint8_t cmd_body[], const uint8_t cmd_data[], const writeMode_t mode,
+																			 const CIVprio_t prio) {
+
+// put the command into the queue and return immediately
+
+	CIVtxHandle_t handle = txEnqueue(deviceAddr, cmd_body, cmd_data, mode, prio);
+
+	if (handle!=0) txService();												// send it immediately, if possible
+	return handle;
+
+}
+
+//:::::::::
+CIVtxHandle_t CIVbase::txEnqueue (const uint8_t deviceAddr, const uint8_t cmd_body[], const uint8_t cmd_data[], const writeMode_t mode,
+																	 const CIVprio_t prio) {
+
+// put the command into the queue (without sending it)
+// return: handle, 0 if the queue is full or the command is too long
+
+	CIVtxSlot_t *slot = NULL;
+	const uint8_t *frame;
+	uint8_t frameL[CIVtxMsgSize];
 	uint8_t idx;
 
-  // copy the message into the log
-  if (msg[0]>(logMsgLength-1)) msg[0] = (logMsgLength-1); // limit the msg to the length of the 
-                                                          // log buffer
-  for (idx=0;idx<=(msg[0]);idx++) {logBuffer[logEntry][idx] = msg[idx];}
+	if ((frame=cachedMsg(deviceAddr, cmd_body, cmd_data))==NULL) {	// first the frame, then a slot
+		if (!buildMsg(frameL, CIVtxMsgSize, deviceAddr, cmd_body, cmd_data)) return 0;	// command too long
+		frame = frameL;																	// (no queued command is replaced for nothing)
+	}
 
-  // copy the name of the entry into the log
-  for (idx=0;idx<logNameLength; idx++)
-	  logBufferName[logEntry][idx] = name[idx];
-  logBufferName[logEntry][logNameLength-1] = '\0'; // just to be on the safe side ....
+	for (idx=0;idx<CIVtxQueueSize;idx++) {						// free element available ?
+		if (_txQueue[idx].state==CIV_txFree) {slot = &_txQueue[idx]; break;}
+	}
+	if (slot==NULL) {																	// no -> overwrite the oldest finished command
+		for (idx=0;idx<CIVtxQueueSize;idx++) {
+			if ((_txQueue[idx].state==CIV_txDone) &&
+					((slot==NULL) || (int16_t(_txQueue[idx].handle-slot->handle)<0)))
+				slot = &_txQueue[idx];
+		}
+	}
+	if (slot==NULL) {																	// no -> replace the newest command of a lower class
+		for (idx=0;idx<CIVtxQueueSize;idx++) {
+			if ((_txQueue[idx].state==CIV_txQueued) && (_txQueue[idx].prio>prio) &&
+					((slot==NULL) || (_txQueue[idx].prio>slot->prio) ||
+					 ((_txQueue[idx].prio==slot->prio) && (int16_t(_txQueue[idx].handle-slot->handle)>0))))
+				slot = &_txQueue[idx];
+		}
+	}
+	if (slot==NULL) return 0;													// queue full
 
-  // copy the state into the log
-  logBufferState[logEntry] = state;
-		
-  if (logEntry<(logMaxEntries-1)) logEntry++;
-	else logEntry=0;
+	memcpy(slot->txBuffer, frame, frame[0]+1);
 
-#endif
+	_txHandle++; if (_txHandle==0) _txHandle++;				// 0 is not a valid handle
+	slot->handle	= _txHandle;
+	slot->mode		= mode;
+	slot->prio		= (prio<CIVprioCount) ? prio : CIV_prioPoll;
+	slot->attempts	= 0;
+	slot->ts_queued	= micros();
+	slot->retVal	= CIV_TX_PENDING;
+	slot->state		= CIV_txQueued;
+
+	return slot->handle;
 
 }
 
-//.............
-void CIV::logDisplayLine(uint8_t lineNo) {
+//:::::::::
+uint8_t CIVbase::writeStatus (const CIVtxHandle_t handle) {
 
-#ifdef log_CIV
+	CIVtxSlot_t *slot;
 
-  uint8_t idx;
- 
-	for (idx=1;idx<=logBuffer[lineNo][0];idx++) {
-		Serial.print(".");
-		Serial.print(logBuffer[lineNo][idx],HEX);
+	slot = txSlot(handle);
+	if (slot==NULL) return CIV_NO_MSG;								// unknown handle
+	if (slot->state!=CIV_txDone) fetchMsg();					// the queue is sent and the echo comes in via receive
+	return slot->retVal;
+
+}
+
+//:::::::::
+uint8_t CIVbase::writeAwait (const CIVtxHandle_t handle) {
+
+	uint8_t retVal;
+
+	while ((retVal = writeStatus(handle)) == CIV_TX_PENDING) delayMicroseconds(t_usLoop);
+
+	return retVal;
+
+}
+
+//:::::::::
+bool CIVbase::txEcho(const uint8_t inByte) {
+
+// check the next byte of the echo (in case of polling the serial interface)
+// return: true, if the byte was part of the echo
+
+	if ((_txActive==NULL) || (_rxRing!=NULL)) return false;
+
+	_txActive->echoIdx++;
+	if (inByte!=_txActive->txBuffer[_txActive->echoIdx]) {	// corrupted, the byte belongs to somebody else
+		txJam(&inByte, 1);
+		logNewEntry(_txActive->txBuffer,CIV_trTXconflict,CIV_BUS_CONFLICT);
+		txDone(*_txActive, CIV_BUS_CONFLICT);
+		return false;
 	}
-	Serial.print(" : ");
-	Serial.print(logBufferName[lineNo]);
-  Serial.print(" * ");
-  Serial.print(logBufferState[lineNo]);
-	Serial.println("");
 
-#endif // log_CIV
+	if (_txActive->echoIdx==_txActive->txBuffer[0]) {				// echo complete and correct
+		logNewEntry(_txActive->txBuffer,CIV_trTXok,CIV_OK);
+		txDone(*_txActive, CIV_OK);
+	}
+	return true;
 
 }
 
-//.............
-void CIV::logDisplay() {
+//:::::::::
+bool CIVbase::txEchoFrame(const uint8_t frame[]) {
 
-#ifdef log_CIV
+// check the echo (in case of a receive ringbuffer, the echo is available as a complete frame)
+// return: true, if the frame was the echo
+
+	uint8_t idx;
 
-	uint8_t entry_idx;
-	uint8_t display_idx=0;
+	if (_txActive==NULL) return false;
 
-	// display oldest lines first
-	for (entry_idx = logEntry; entry_idx < logMaxEntries; entry_idx++) {
-		if (logBuffer[entry_idx][0]>0) {
-			logDisplayLine(entry_idx);
-			display_idx++;
+	for (idx=0; idx<=_txActive->txBuffer[0]; idx++) {
+		if (frame[idx]!=_txActive->txBuffer[idx]) {
+			txJam(&frame[1], frame[0]);
+			logNewEntry(frame,CIV_trTXconflict,CIV_BUS_CONFLICT);
+			txDone(*_txActive, CIV_BUS_CONFLICT);
+			return true;
 		}
 	}
-	// display latest lines last
-	for (entry_idx = 0; entry_idx < logEntry; entry_idx++) {
-		logDisplayLine(entry_idx);
-		display_idx++;
+	logNewEntry(frame,CIV_trTXok,CIV_OK);
+	txDone(*_txActive, CIV_OK);
+	return true;
+
+}
+
+//:::::::::
+void CIVbase::txDone(CIVtxSlot_t &slot, const uint8_t retVal) {
+
+	if (&slot==_txActive) _txActive = NULL;
+
+	if (txRetry(retVal, slot.attempts)) {							// collision -> back into the queue
+		slot.state		= CIV_txQueued;
+		slot.ts_sent	= micros() + txBackoff(slot.attempts);	// not to be sent before this time
+		return;
 	}
-  if (display_idx>0) Serial.println("**");
 
-#endif // log_CIV
+	slot.retVal	= retVal;
+	slot.state	= CIV_txDone;
+	statsCount(_stats.txRetVal[retVal]);
+
+	if (retVal==CIV_OK) {															// on the bus -> the device will answer
+		expectAnswer(slot.txBuffer[3], slot.handle);
+		reqSent(slot.handle);
+	}
 
 }
 
+//:::::::::
+bool CIVbase::txRetry(const uint8_t retVal, const uint8_t attempts) {
 
-//------------------------------------------------------------------------
-// private methods
-
-// in order to make the support of other serial-interfaces easier,
-// an extra set of internal CIV-bus access routines have been created
-
-//::::::::: 
-uint8_t CIV::serAvailable() {
-#if defined(ESP32)
-	if (_ESP_BT)
-		return CIV_BTSER.available();
-	else	
-		return CIV_SERIAL.available();
-#else
-	return CIV_SERIAL.available();
-#endif
-}
+// bookkeeping of the retransmission engine after a transmission (writeMsg or queue)
+// return: true, if the frame shall be sent again
 
-//::::::::: 
-void CIV::serWrite(uint8_t ch) {
-#if defined(ESP32)
-	if (_ESP_BT)
-		CIV_BTSER.write(ch);
+	if ((retVal!=CIV_BUS_CONFLICT) && (retVal!=CIV_BUS_BUSY)) {
+		if (retVal==CIV_OK) _conflictsInRow = 0;				// the bus is working
+		return false;
+	}
+
+	if (retVal==CIV_BUS_CONFLICT) {
+		_retryCounters.conflicts++;
+		if (_conflictsInRow<255) _conflictsInRow++;
+	}
 	else
-		CIV_SERIAL.write(ch);
-#else
-	CIV_SERIAL.write(ch);
-#endif
+		_retryCounters.busy++;
+
+	if (_retryMax<=1) return false;									// retransmission not in use
+
+	if ((attempts>=_retryMax) || busJammed()) {
+		_retryCounters.gaveUp++;
+		return false;
+	}
+
+	_retryCounters.retries++;
+	return true;
+
 }
 
-//::::::::: 
-uint8_t CIV::serRead() {
-#if defined(ESP32)
-	if (_ESP_BT)
-		return CIV_BTSER.read();
-	else
-		return CIV_SERIAL.read();
-#else
-	return CIV_SERIAL.read();	
-#endif
+//:::::::::
+unsigned long CIVbase::txBackoff(const uint8_t attempts) {
+
+// randomised exponential backoff: random time out of [window/2, window], window = min * 2^(attempts-1) <= max
+
+	unsigned long window = _retryMin;
+	uint8_t idx;
+
+	for (idx=1; (idx<attempts) && (window<_retryMaxWait); idx++) window <<= 1;
+	if (window>_retryMaxWait) window = _retryMaxWait;
+
+	_rnd ^= _rnd << 13; _rnd ^= _rnd >> 17; _rnd ^= _rnd << 5;		// xorshift32
+	return window/2 + (_rnd % (window/2 + 1));
+
 }
 
-//::::::::: 
-void CIV::serflushOutput(){
+//:::::::::
+void CIVbase::setTiming(const unsigned long baudrate) {
 
-#if defined(ESP32)
-	if (_ESP_BT)
-		CIV_BTSER.flush();
-	else
-		CIV_SERIAL.flush();
-#elif defined(useAltSoftSerial)
-	CIV_SERIAL.flushOutput();
-#else
-	CIV_SERIAL.flush();
-#endif
+// waiting times of the bus: transmission time of the bytes expected + latency of the interface / the radio
+
+	_timing.baudrate		= baudrate;
+	_timing.t_usByte		= (10000000UL + baudrate-1)/baudrate;	// 10 bits per byte
+	_timing.t_usRxFrame	= CIVrxGapBytes*_timing.t_usByte + t_usRxLatency;
+	_timing.t_readMsg		= (CIVframeMaxLen*_timing.t_usByte + t_usTurnaround)/t_usLoop;
+
+	if (_rxRing!=NULL) _rxRing->setFrameTimeout(_timing.t_usRxFrame);
+
+}
+
+//:::::::::
+void CIVbase::txWait(const unsigned long t_us) {
+
+	if (t_us>=1000) delay(t_us/1000);									// delayMicroseconds is limited to 16383us (AVR)
+	delayMicroseconds(t_us%1000);
+
+}
+
+//:::::::::
+bool CIVbase::txJam(const uint8_t frame[], const uint8_t len) {
+
+// jammer code instead of the own echo? (counted in retryCounters.jamCodes)
+
+	if (memchr(frame, C_JAM, len)==NULL) return false;
+	_retryCounters.jamCodes++;
+	return true;
+
+}
+
+//:::::::::
+CIVtxSlot_t *CIVbase::txNext() {
+
+// next command of the queue to be sent: highest class first (incl. aging), within a class the oldest one
+// (commands waiting for the backoff of their retransmission are skipped, so they don't block the others)
+// return: NULL, if nothing is ready to be sent
+
+	CIVtxSlot_t *slot, *next = NULL;
+	unsigned long now = micros();
+	uint8_t idx, prio, nextPrio = 0;
+	unsigned long waited;
+
+	for (idx=0;idx<CIVtxQueueSize;idx++) {
+		slot = &_txQueue[idx];
+		if (slot->state!=CIV_txQueued) continue;
+		if ((slot->attempts>0) && (long(now-slot->ts_sent)<0)) continue;	// retransmission: backoff not over yet
+
+		waited = (now-slot->ts_queued)/t_usPrioAging;		// starvation protection
+		prio = (waited>=slot->prio) ? 0 : slot->prio-waited;
+
+		if ((next==NULL) || (prio<nextPrio) ||
+				((prio==nextPrio) && (int16_t(slot->handle-next->handle)<0))) {
+			next = slot; nextPrio = prio;
+		}
+	}
+	return next;
+
+}
+
+//:::::::::
+CIVtxSlot_t *CIVbase::txSlot(const CIVtxHandle_t handle) {
+
+	uint8_t idx;
+
+	if (handle==0) return NULL;
+	for (idx=0;idx<CIVtxQueueSize;idx++) {
+		if ((_txQueue[idx].state!=CIV_txFree) && (_txQueue[idx].handle==handle)) return &_txQueue[idx];
+	}
+	return NULL;
+
+}
+
+
+//:::::::::
+CIVreqHandle_t CIVbase::requestMsg (const uint8_t deviceAddr, const uint8_t cmd_body[], const uint8_t cmd_data[],
+																		const unsigned long t_usTimeout, const uint8_t retries,
+																		const CIVprio_t prio, const writeMode_t mode) {
+
+// send the command and register it in the table of pending requests
+
+	CIVreq_t *req = NULL;
+	CIVtxHandle_t txHandle;
+	uint8_t idx;
+
+	if ((cmd_data[0]==0) && (cmd_body[0]<sizeof(req->query)) &&				// same query of another caller ?
+			((req=reqShared(deviceAddr, cmd_body))!=NULL)) {
+		_reqCoalesced++;
+		return req->handle;
+	}
+
+	for (idx=0;idx<CIVreqTableSize;idx++) {						// free element available ?
+		if (_reqTable[idx].state==CIV_reqFree) {req = &_reqTable[idx]; break;}
+	}
+	if (req==NULL) {																	// no -> overwrite the oldest finished request
+		for (idx=0;idx<CIVreqTableSize;idx++) {
+			if ((_reqTable[idx].state==CIV_reqDone) &&
+					((req==NULL) || (int16_t(_reqTable[idx].handle-req->handle)<0)))
+				req = &_reqTable[idx];
+		}
+	}
+	if (req==NULL) return 0;													// all requests are pending
+
+	txHandle = txEnqueue(deviceAddr, cmd_body, cmd_data, mode, prio);	// (sent below, when the request is known)
+	if (txHandle==0) return 0;												// queue full or command too long
+
+	_reqHandle++; if (_reqHandle==0) _reqHandle++;		// 0 is not a valid handle
+	req->handle					= _reqHandle;
+	req->state					= CIV_reqPending;
+	req->retries				= retries;
+	req->txHandle				= txHandle;
+	req->sent						= false;
+	req->cmd_body				= cmd_body;
+	req->cmd_data				= cmd_data;
+	req->prio						= prio;
+	req->mode						= mode;
+	req->query[0]				= 0;
+	if ((cmd_data[0]==0) && (cmd_body[0]<sizeof(req->query))) memcpy(req->query, cmd_body, cmd_body[0]+1);
+	req->t_usTimeout		= t_usTimeout;
+	req->result					= CIVmsgRef::noMsg;
+	req->result.retVal	= CIV_TX_PENDING;
+	req->result.address	= deviceAddr;
+	_reqPending++;
+
+	txService();																			// send it immediately, if possible
+
+	return req->handle;
+
+}
+
+//:::::::::
+uint8_t CIVbase::requestStatus (const CIVreqHandle_t handle) {
+
+	CIVreq_t *req = reqSlot(handle);
+
+	if (req==NULL) return CIV_NO_MSG;									// unknown handle
+	if (req->state==CIV_reqPending) {
+		fetchMsg();																			// the answer comes in via receive
+		reqService();
+	}
+	return req->result.retVal;
+
+}
+
+//:::::::::
+const CIVresult_t &CIVbase::requestResult (const CIVreqHandle_t handle) {
+
+	CIVreq_t *req = reqSlot(handle);
+
+	if ((req==NULL) || (req->state!=CIV_reqDone)) return CIVmsgRef::noMsg;
+	return req->result;
+
+}
+
+//:::::::::
+uint8_t CIVbase::requestsPending (const uint8_t deviceAddr) {
+
+	uint8_t idx, count = 0;
+
+	for (idx=0;idx<CIVreqTableSize;idx++) {
+		if ((_reqTable[idx].state==CIV_reqPending) && (_reqTable[idx].result.address==deviceAddr)) count++;
+	}
+	return count;
+
+}
+
+//:::::::::
+void CIVbase::reqMatch(const CIVresult_t &msg, const uint8_t dstAddr) {
+
+// assign an incoming message to the oldest matching request of its device, which is on the bus:
+// data -> same command/subcommand(s); CIV_OK/CIV_NOK -> the oldest frame sent to the device
+// (the answers come in the order of the frames, the frame may belong to writeMsg as well)
+
+	CIVreq_t *req, *match = NULL;
+	uint8_t idx, len, first, expectIdx = CIV_SLOT_NONE;
+
+	if ((_expectCount==0) || (msg.retVal>CIV_NOK) || (dstAddr!=CIV_ADDR_MASTER)) return;	// (broadcast)
+
+	expectPurge();
+	for (idx=0;idx<_expectCount;idx++) {							// oldest frame of the device
+		if (_expect[idx].address==msg.address) {expectIdx = idx; break;}
+	}
+	if (expectIdx==CIV_SLOT_NONE) return;							// nothing sent to the device (not an answer)
+
+	for (idx=0;idx<CIVreqTableSize;idx++) {
+		req = &_reqTable[idx];
+		if ((req->state!=CIV_reqPending) || !req->sent || (req->result.address!=msg.address)) continue;
+		if (msg.retVal==CIV_OK_DAV) {
+			len = (msg.cmd[0]<req->cmd_body[0]) ? msg.cmd[0] : req->cmd_body[0];
+			if ((len==0) || (memcmp(&msg.cmd[1], &req->cmd_body[1], len)!=0)) continue;
+			if ((match==NULL) || (int16_t(req->handle-match->handle)<0)) match = req;
+		}
+		else if (req->txHandle==_expect[expectIdx].txHandle) match = req;
+	}
+
+	if ((match!=NULL) && (msg.retVal==CIV_OK_DAV)) {	// its own frame has got the answer
+		first = expectIdx; expectIdx = CIV_SLOT_NONE;
+		for (idx=first;idx<_expectCount;idx++) {
+			if (_expect[idx].txHandle==match->txHandle) {expectIdx = idx; break;}
+		}
+	}
+	expectDrop(expectIdx);														// the frame has got its answer
+	if (match==NULL) return;													// no request (e.g. writeMsg)
+
+	match->result		= msg;
+	match->state		= CIV_reqDone;
+	match->ts_done	= micros();
+	_reqPending--;
+	statsTime(_stats.reqLatency, match->ts_done-(match->ts_deadline-match->t_usTimeout));	// (since the last attempt)
+
+}
+
+//:::::::::
+void CIVbase::reqService() {
+
+// supervision of the pending requests: transmission failed or no answer in time -> send it again or give up
+
+	CIVreq_t *req;
+	CIVtxSlot_t *slot;
+	uint8_t idx, retVal;
+
+	if (_reqPending==0) return;
+
+	for (idx=0;idx<CIVreqTableSize;idx++) {
+		req = &_reqTable[idx];
+		if (req->state!=CIV_reqPending) continue;
+
+		retVal = CIV_TX_PENDING;
+		if (req->sent) {
+			if (long(micros()-req->ts_deadline)>0) retVal = CIV_REQ_TIMEOUT;	// no answer in time
+		}
+		else {
+			slot = txSlot(req->txHandle);
+			if (slot==NULL) {reqSend(*req); continue;}	// replaced by a command of a higher class -> queue it again
+			if ((slot->state==CIV_txDone) && (slot->retVal!=CIV_OK))
+				retVal = slot->retVal;											// the command didn't get onto the bus
+		}
+		if (retVal==CIV_TX_PENDING) continue;						// still in the queue or waiting for the answer
+
+		if (retVal==CIV_REQ_TIMEOUT) {
+			CIVmailbox_t *mbx = mailbox(req->result.address);
+			if (mbx!=NULL) statsCount(_stats.device[mbx-_mailbox].reqTimeouts);
+			for (uint8_t ex=0;ex<_expectCount;ex++) {		// the answer is not expected any more
+				if (_expect[ex].txHandle==req->txHandle) {expectDrop(ex); break;}
+			}
+		}
+
+		if (req->retries>0) {														// -> once more
+			req->retries--;
+			reqSend(*req);
+		}
+		else {
+			req->result.retVal	= retVal;
+			req->state					= CIV_reqDone;
+			_reqPending--;
+		}
+	}
+
+}
+
+//:::::::::
+void CIVbase::reqSend(CIVreq_t &req) {
+
+// queue the command of the request (again); the deadline starts, when it is on the bus (reqSent)
+// if the queue is full, this is tried again by the next reqService
+
+	req.sent			= false;
+	req.txHandle	= txEnqueue(req.result.address, req.cmd_body, req.cmd_data, req.mode, req.prio);
+	if (req.txHandle!=0) txService();
 
 }
 
+//:::::::::
+void CIVbase::reqSent(const CIVtxHandle_t txHandle) {
+
+	CIVreq_t *req;
+	uint8_t idx;
+
+	if (_reqPending==0) return;
+
+	for (idx=0;idx<CIVreqTableSize;idx++) {
+		req = &_reqTable[idx];
+		if ((req->state==CIV_reqPending) && !req->sent && (req->txHandle==txHandle)) {
+			req->sent					= true;
+			req->ts_deadline	= micros() + req->t_usTimeout;
+			return;
+		}
+	}
+
+}
+
+//:::::::::
+void CIVbase::expectAnswer(const uint8_t deviceAddr, const CIVtxHandle_t txHandle) {
+
+// a frame has been sent to the device -> its answer is expected (the oldest one is dropped, if the table is full)
+
+	if (deviceAddr==CIV_ADDR_ALL) return;							// (no answer to a frame to all)
+
+	expectPurge();
+	if (_expectCount==CIVexpectSize) expectDrop(0);
+	_expect[_expectCount].address		= deviceAddr;
+	_expect[_expectCount].txHandle	= txHandle;
+	_expect[_expectCount].ts_sent		= micros();
+	_expectCount++;
+
+}
+
+//:::::::::
+void CIVbase::expectDrop(const uint8_t idx) {
+
+	if (idx>=_expectCount) return;
+	memmove(&_expect[idx], &_expect[idx+1], (_expectCount-idx-1)*sizeof(CIVexpect_t));
+	_expectCount--;
+
+}
+
+//:::::::::
+void CIVbase::expectPurge() {
+
+// frames without a pending request, which haven't been answered within t_usRequest, won't get an answer any more
+// (the frames of the requests are dropped by reqService after their own deadline)
+
+	uint8_t idx, ex = 0;
+	bool request;
+
+	while (ex<_expectCount) {
+		request = false;
+		if (_expect[ex].txHandle!=0) {
+			for (idx=0;idx<CIVreqTableSize;idx++) {
+				if ((_reqTable[idx].state==CIV_reqPending) && (_reqTable[idx].txHandle==_expect[ex].txHandle))
+					{request = true; break;}
+			}
+		}
+		if (!request && ((micros()-_expect[ex].ts_sent)>t_usRequest)) expectDrop(ex);
+		else ex++;
+	}
+
+}
+
+//:::::::::
+CIVreq_t *CIVbase::reqShared(const uint8_t deviceAddr, const uint8_t cmd_body[]) {
+
+// request of the same query (device + command without data), which is pending or has been answered recently
+// (the youngest one, if there are several)
+
+	CIVreq_t *req, *shared = NULL;
+	uint8_t idx;
+
+	for (idx=0;idx<CIVreqTableSize;idx++) {
+		req = &_reqTable[idx];
+		if ((req->state==CIV_reqFree) || (req->result.address!=deviceAddr) || (req->query[0]==0) ||
+				(memcmp(req->query, cmd_body, cmd_body[0]+1)!=0)) continue;
+		if ((req->state==CIV_reqDone) &&																		// answered -> still fresh ?
+				((req->result.retVal>CIV_NOK) || ((micros()-req->ts_done)>_reqCoalesceWindow))) continue;
+		if ((shared==NULL) || (int16_t(req->handle-shared->handle)>0)) shared = req;
+	}
+	return shared;
+
+}
+
+//:::::::::
+CIVreq_t *CIVbase::reqSlot(const CIVreqHandle_t handle) {
+
+	uint8_t idx;
+
+	if (handle==0) return NULL;
+	for (idx=0;idx<CIVreqTableSize;idx++) {
+		if ((_reqTable[idx].state!=CIV_reqFree) && (_reqTable[idx].handle==handle)) return &_reqTable[idx];
+	}
+	return NULL;
+
+}
+
+
+//::::::::::::: statistics
+
+//:::::::::
+void CIVbase::statsSnapshot(CIVstats_t &snapshot, const bool reset) {
+
+	snapshot = _stats;
+	if (reset) statsReset();
+
+}
+
+//:::::::::
+void CIVbase::statsReset() {
+
+	uint8_t idx;
+
+	memset(&_stats,0,sizeof(_stats));
+	for (idx=0;idx<CIVmailboxCount;idx++)								// the registered devices stay
+		_stats.device[idx].address = _mailbox[idx].address;
+
+}
+
+//:::::::::
+unsigned long CIVbase::statsPercentile(const CIVhist_t &hist, const uint8_t percent) {
+
+	uint64_t total = 0, sum = 0;
+	uint8_t idx;
+
+	for (idx=0;idx<CIVhistBuckets;idx++) total += hist.bucket[idx];
+	if (total==0) return 0;
+
+	for (idx=0;idx<CIVhistBuckets-1;idx++) {
+		sum += hist.bucket[idx];
+		if (sum*100 >= total*percent)												// upper limit of the bucket
+			return ((1UL<<(idx*CIVhistShift))-1 < hist.max) ? (1UL<<(idx*CIVhistShift))-1 : hist.max;
+	}
+	return hist.max;																		// the last bucket is open
+
+}
+
+//:::::::::
+void CIVbase::statsTime(CIVhist_t &hist, const unsigned long t_us) {
+
+// bucket n: 2^((n-1)*CIVhistShift) <= t_us < 2^(n*CIVhistShift) (bucket 0: t_us = 0)
+
+	unsigned long t = t_us;
+	uint8_t idx = 0;
+
+	while ((t>0) && (idx<CIVhistBuckets-1)) {t >>= CIVhistShift; idx++;}
+	statsCount(hist.bucket[idx]);
+	if (t_us>hist.max) hist.max = t_us;
+
+}
+
+//:::::::::
+void CIVbase::statsFrame(const CIVresult_t &msg) {
+
+	CIVmailbox_t *mbx = mailbox(msg.address);
+
+	statsCount(_stats.rxRetVal[msg.retVal]);
+	if (mbx==NULL) {statsCount(_stats.otherFrames); return;}
+
+	CIVaddrStats_t &device = _stats.device[mbx-_mailbox];
+	statsCount(device.frames);
+	if (msg.retVal==CIV_NOK) statsCount(device.nok);
+
+}
+
+
+//::::::::::::: logging
+
+//.............
+void CIVbase::logClear() {
+  #ifdef log_CIV
+		_trace.clear();
+  #endif
+}
+
+//.............
+void CIVbase::logDisplay() {
+
+#ifdef log_CIV
+
+	if (_trace.used()==0) return;
+
+	_trace.print(Serial);														// oldest entries first
+	Serial.println("**");
+
+#endif // log_CIV
+
+}
+
+
 //------------------------------------------------------------------------
 // private static variables
 
@@ -24,7 +24,7 @@
 // has to be initialized in the main program
 
 //  #define log_CIV           // switch on logging (command-structured, in and out)
-															// ringbuffer
+															// binary ringbuffer with timestamps (CIVtrace)
 															
 //  #define debugWithoutRadio // if defined, no reaction of a radio is expected
                               // dummy receive data are used instead 
@@ -42,15 +42,30 @@
   #define useAltSoftSerial
 #elif defined(ARDUINO_AVR_MEGA2560)
   #define useSerial_1
+	#define CIV_SERIAL Serial1
 	#define bigRamAv
 #elif defined(ESP32)
   #define useSerial_2
+	#define CIV_SERIAL Serial2
 	#define useBluetooth
 	#define bigRamAv
+//	#define useBTonly						// "CIV" uses Bluetooth instead of Serial2 (e.g. a standalone IC705)
+#elif !defined(ARDUINO)
+	#define useHost								// Linux host (no Arduino core): see CIVhost.h
+	#define bigRamAv
 #endif
 
-// Note: If you are using an ESP32 and want to use the Bluetooth interface to control an IC-705, simple pass "true"
-// as an parameter to the setupp method !
+// The interface in use is a template parameter of the class CIVbus (see CIVtransport.h).
+// "CIV" is the CIVbus with the default interface of the board selected above:
+//	 Uno, Nano, Pro, Pro mini: 	AltSoftSerial
+//	 Mega2560:									Serial1
+//	 ESP32:											Serial2 (Bluetooth, if useBTonly is defined)
+//	 Linux host:								in-memory loopback (CIVptyTransport for a tty/pty)
+
+// Note: If you are using an ESP32 and want to use the Bluetooth interface to control an IC-705, create the
+// civ object as "CIVbus<CIVbtTransport> civ;" (or define useBTonly above). If the interface has to be
+// selected at runtime by setupp(true/false), "CIVbus<CIVesp32Transport> civ;" does this (at the cost of
+// an indirect call per byte).
 
 // It is highly probable, that you are running out of memory in the case you are using Bluetooth on ESP32
 // there is a simple solution for that: go in the Arduino IDE to "tools" and change the "Partition Scheme" 
@@ -64,8 +79,19 @@
 	#include "BluetoothSerial.h"
 #endif
 
+#ifdef useHost
+	#include "CIVhost.h"
+	#include <thread>
+#endif
+
+// index type of the lock-free ringbuffers (single producer / single consumer)
+#if defined(useHost) || defined(ESP32)
+	#include <atomic>
+	#define CIV_ATOMIC_IDX
+#endif
+
 // general serial interface switches (do NOT apply for BT! )
-#define CIV_BAUDRATE 19200
+#define CIV_BAUDRATE 19200		// default, another baudrate can be chosen by setupp(CIVbaud_t)
 
 #define UART_TIMEOUT 1000
 
@@ -92,23 +118,105 @@ typedef struct {
   unsigned long value;
 } CIVresult_t;
 
-#ifdef bigRamAv
+// number of slots for received messages (readMsg, max. 127)
+#if defined(useHost)
+	constexpr uint8_t  CIVresultBufSize = 32;
+#elif defined(bigRamAv)
 	constexpr uint8_t  CIVresultBufSize = 6;
 #else
 	constexpr uint8_t  CIVresultBufSize = 3;
 #endif
 
+// slot for a received message: the message is decoded directly into the slot and stays there,
+// until it has been released by the receiver
+enum CIVslotState_t:uint8_t {
+	CIV_slotFree,															// empty
+	CIV_slotFull,															// message for a known device, not fetched yet
+	CIV_slotLent															// handed over to the receiver (CIVmsgRef)
+};
+
+typedef struct {
+	CIVresult_t		result;
+	CIVslotState_t	state;
+	uint8_t				next;												// next message in the same mailbox (index of the slot)
+} CIVmsgSlot_t;
+
+constexpr uint8_t  CIV_SLOT_NONE = 0xFF;					// end of the mailbox queue
+
+// view of a received message in its slot (see readMsgRef); the slot is released by release()
+// or automatically, when the CIVmsgRef goes out of scope. CIVmsgRef can be moved, but not copied.
+// If no message is available, the CIVmsgRef is empty ("false") and shows CIV_NO_MSG.
+class CIVmsgRef {
+
+public:
+
+	CIVmsgRef() : _slot(NULL) {}
+	CIVmsgRef(CIVmsgRef &&other) : _slot(other._slot)			{other._slot = NULL;}
+	CIVmsgRef &operator=(CIVmsgRef &&other)
+		{if (this!=&other) {release(); _slot = other._slot; other._slot = NULL;} return *this;}
+	~CIVmsgRef()																					{release();}
+
+	CIVmsgRef(const CIVmsgRef &) = delete;
+	CIVmsgRef &operator=(const CIVmsgRef &) = delete;
+
+	explicit operator bool() const												{return (_slot!=NULL);}
+	const CIVresult_t &operator*() const									{return (_slot!=NULL) ? _slot->result : noMsg;}
+	const CIVresult_t *operator->() const									{return &(**this);}
+
+	void		release()																			{if (_slot!=NULL) _slot->state = CIV_slotFree; _slot = NULL;}
+
+private:
+
+	friend class CIVbase;
+	explicit CIVmsgRef(CIVmsgSlot_t *slot) : _slot(slot)		{slot->state = CIV_slotLent;}
+
+	CIVmsgSlot_t	*_slot;
+
+	static const CIVresult_t noMsg;
+
+}; // end class CIVmsgRef
 
-constexpr uint8_t  knownAddrListSize = 3;
+
+// number of devices (addresses) which can be registered in CIV (one mailbox each)
+#ifdef bigRamAv
+	constexpr uint8_t  CIVmailboxCount = 16;
+#else
+	constexpr uint8_t  CIVmailboxCount = 4;
+#endif
+
+// mailbox of a registered device: queue of the messages received (slots of CIVresultBuf), oldest first
+typedef struct {
+	uint8_t	address;														// CIV_ADDR_NONE: mailbox is not in use
+	uint8_t	head;																// oldest message, CIV_SLOT_NONE if empty
+	uint8_t	tail;																// newest message
+	uint8_t	count;															// no of messages in the mailbox
+	uint16_t	dropped;													// messages of this device lost because of an overflow
+} CIVmailbox_t;
+
+// what happens with a new message of a registered device, if CIVresultBuf is full (see setOverflowPolicy)
+enum CIVoverflow_t:uint8_t {
+	CIV_ovfStall,															// nothing is read from the bus any more, until space is available
+	CIV_ovfDropOldest,												// the oldest message of the device with the most messages is dropped (default)
+	CIV_ovfDropNewest,												// the new message is dropped
+	CIV_ovfCoalesce														// an older message with the same command of the same device is replaced,
+																						// otherwise as CIV_ovfDropOldest (only if full, i.e. all messages
+																						// are kept, as long as there is room for them)
+};
+
+// counters of the messages lost or replaced
+typedef struct {
+	uint16_t	droppedOldest;										// old messages dropped in favour of a new one
+	uint16_t	droppedNewest;										// new messages dropped
+	uint16_t	droppedQuota;											// messages dropped because the device exceeded its quota
+	uint16_t	coalesced;												// messages replaced by a newer one with the same command
+} CIVovfCounters_t;
 
 // time definitions in multiple of 1ms
 #define t_msDelay_5ms 5
 
 // time definitions based on no of loops
 
-#define t_sendCmd       t_usLoop_10ms
 #define t_waitForRadio  t_usLoop_100ms
-#define t_readMsg       t_usLoop_40ms
 
 constexpr uint8_t  t_usLoop = 50;
 
@@ -134,7 +242,10 @@ enum retVal_t :uint8_t {
 	CIV_HW_FAULT     =  3,
 	CIV_BUS_BUSY     =  4,
 	CIV_BUS_CONFLICT =  5,
-	CIV_NO_MSG    	 =  6
+	CIV_NO_MSG    	 =  6,
+	CIV_MSG_PENDING  =  7,	// readMsgRaw only: a frame is being received, but it's not complete yet
+	CIV_TX_PENDING   =  8,	// writeStatus/requestStatus only: the command is waiting for the bus, its echo or the answer
+	CIV_REQ_TIMEOUT  =  9		// requestStatus only: no answer from the device within the deadline (incl. retries)
 };
 
 // state of the CIV-bus
@@ -145,13 +256,253 @@ enum CIV_State_t:uint8_t {
 	CIV_stop		= 3
 };
 
+// baudrates of the radios (CI-V USB/REMOTE port)
+enum CIVbaud_t:uint32_t {
+	CIV_baudNone		=      0,		// autoBaud: no answer at any baudrate
+	CIV_baud4800		=   4800,
+	CIV_baud9600		=   9600,
+	CIV_baud19200		=  19200,
+	CIV_baud38400		=  38400,
+	CIV_baud57600		=  57600,
+	CIV_baud115200	= 115200
+};
+
+// the waiting times of the bus are derived from the baudrate (CIVbase::setTiming):
+// transmission time of the bytes expected (10 bits per byte) + latency of the interface / the radio
+constexpr unsigned long t_usTurnaround = 3000;			// echo resp. start of the radio's answer [us]
+constexpr unsigned long t_usRxLatency  = 16000;			// gap within a frame caused by the interface (e.g. USB) [us]
+constexpr uint8_t				CIVframeMaxLen = CIV_TXBUFFERSIZE;	// longest frame expected [bytes]
+constexpr uint8_t				CIVrxGapBytes  = 2;					// max. gap between two bytes of a frame (+ t_usRxLatency) [bytes]
+constexpr unsigned long t_usAutoBaud   = 100000;		// autoBaud: waiting time for the answer per baudrate [us]
+
+// timeout for an incomplete frame in the receiver, based on us (at CIV_BAUDRATE; BT: always)
+// (if no further byte is received within this time, the frame will be discarded - the time is measured
+// from the last byte received, not from the start of the frame)
+constexpr unsigned long t_usByte    = 10000000UL/CIV_BAUDRATE;		// 10 bits per byte
+constexpr unsigned long t_usRxFrame = CIVrxGapBytes*t_usByte + t_usRxLatency;
+
+typedef struct {
+	unsigned long		baudrate;
+	unsigned long		t_usByte;										// transmission of one byte
+	unsigned long		t_usRxFrame;								// an incomplete frame is discarded after this gap
+	uint16_t				t_readMsg;									// [t_usLoop] waiting for the rest of a frame, before sending
+} CIVtiming_t;
+
+
+// queue of the commands sent by writeMsgAsync
+#ifdef bigRamAv
+	constexpr uint8_t  CIVtxQueueSize = 8;
+	constexpr uint8_t  CIVtxMsgSize   = CIV_TXBUFFERSIZE;
+#else
+	constexpr uint8_t  CIVtxQueueSize = 2;
+	constexpr uint8_t  CIVtxMsgSize   = 24;
+#endif
+
+// retransmission after a collision on the bus (see setRetryPolicy)
+// the waiting time before the n-th retransmission is chosen at random out of
+// [window/2, window], window = t_usBackoffMin * 2^(n-1), but max. t_usBackoffMax
+constexpr unsigned long t_usBackoffMin = 2000;
+constexpr unsigned long t_usBackoffMax = 64000;
+constexpr uint8_t  CIVjamLimit = 8;			// collisions in a row -> the bus is regarded as jammed, no retransmissions
+
+// counters of the retransmission engine
+typedef struct {
+	uint16_t	conflicts;												// collisions (CIV_BUS_CONFLICT)
+	uint16_t	busy;															// bus not available (CIV_BUS_BUSY, writeMsg only)
+	uint16_t	jamCodes;													// jammer codes (C_JAM) received instead of the own echo
+	uint16_t	retries;													// retransmissions
+	uint16_t	gaveUp;														// frames given up after the max. no of attempts or due to jamming
+} CIVretryCounters_t;
+
+// cache of complete frames of recurring commands without data (queries like CIV_C_F_READ, CIV_C_TRX_ID ...)
+// -> no need to build the frame again for every cyclic poll
+#ifdef bigRamAv
+	constexpr uint8_t  CIVtxCacheSize = 8;
+#else
+	constexpr uint8_t  CIVtxCacheSize = 2;
+#endif
+constexpr uint8_t  CIVtxCacheMsgSize = 11;		// FE FE to fm + Cmd (up to 4 bytes) + FD + length byte
+
+// priority classes of the commands in the queue of writeMsgAsync: the highest class queued is sent first
+enum CIVprio_t:uint8_t {
+	CIV_prioUrgent	= 0,		// control, e.g. PTT/TX state, power off, interlocks
+	CIV_prioUser		= 1,		// user actions (default)
+	CIV_prioPoll		= 2			// cyclic background polling
+};
+constexpr uint8_t  CIVprioCount = 3;
+// starvation protection: a command waiting longer than this climbs up one class [us]
+constexpr unsigned long t_usPrioAging = 100000;
+
+// queueing latency of a priority class (time from writeMsgAsync to the first transmission)
+typedef struct {
+	uint16_t			count;										// no of commands sent
+	unsigned long	sum;											// [us] -> average = sum/count
+	unsigned long	max;											// [us]
+} CIVtxLatency_t;
+
+// handle of a command sent by writeMsgAsync (0: invalid, i.e. not queued)
+typedef uint16_t CIVtxHandle_t;
+
+// state of an element in the queue of writeMsgAsync
+enum CIVtxState_t:uint8_t {
+	CIV_txFree		= 0,
+	CIV_txQueued	= 1,		// waiting for the bus
+	CIV_txEcho		= 2,		// sent, waiting for the echo
+	CIV_txDone		= 3			// finished, retVal is valid
+};
+
+typedef struct {
+	CIVtxHandle_t	handle;
+	CIVtxState_t	state;
+	writeMode_t		mode;
+	CIVprio_t			prio;
+	uint8_t				retVal;
+	uint8_t				echoIdx;								// no of echo bytes already checked
+	uint8_t				attempts;								// no of transmissions so far (see setRetryPolicy)
+	unsigned long	ts_sent;								// timestamp [us] of the transmission / earliest retransmission
+	unsigned long	ts_queued;							// timestamp [us] of writeMsgAsync
+	uint8_t				txBuffer[CIVtxMsgSize];	// txBuffer[0]: length of the frame
+} CIVtxSlot_t;
+
+// table of the requests waiting for an answer (see requestMsg)
+// (without bigRamAv: the two queries of ICradio + one request of the application)
+#ifdef bigRamAv
+	constexpr uint8_t  CIVreqTableSize = 8;
+#else
+	constexpr uint8_t  CIVreqTableSize = 3;
+#endif
+constexpr unsigned long t_usRequest = 100000;	// default deadline for the answer of a request [us]
+constexpr unsigned long t_usCoalesce = 50000;	// default: answers of queries younger than this are shared [us]
+
+// frames on the bus, which are waiting for the answer of their device (oldest first);
+// CIV_OK/CIV_NOK are assigned in the order of the transmissions
+#ifdef bigRamAv
+	constexpr uint8_t  CIVexpectSize = 8;
+#else
+	constexpr uint8_t  CIVexpectSize = 3;
+#endif
+
+typedef struct {
+	uint8_t					address;								// device addressed
+	CIVtxHandle_t		txHandle;								// transmission of writeMsgAsync/requestMsg, 0: writeMsg
+	unsigned long		ts_sent;								// [us]
+} CIVexpect_t;
+
+// handle of a request (0: invalid)
+typedef uint16_t CIVreqHandle_t;
+
+enum CIVreqState_t:uint8_t {
+	CIV_reqFree		= 0,
+	CIV_reqPending	= 1,		// in the queue of writeMsgAsync or sent, waiting for the answer
+	CIV_reqDone		= 2			// finished, result is valid
+};
+
+typedef struct {
+	CIVreqHandle_t	handle;
+	CIVreqState_t		state;
+	uint8_t					retries;								// retransmissions left
+	CIVtxHandle_t		txHandle;								// handle of the transmission in the queue
+	bool						sent;										// on the bus, the deadline is running
+	const uint8_t		*cmd_body;							// the arrays of the command have to exist, until
+	const uint8_t		*cmd_data;							// the request is finished
+	CIVprio_t				prio;
+	writeMode_t			mode;
+	uint8_t					query[5];								// copy of cmd_body, if it's a query (coalescing), else query[0]=0
+	unsigned long		t_usTimeout;
+	unsigned long		ts_deadline;						// [us], valid if sent
+	unsigned long		ts_done;								// time of the answer [us]
+	CIVresult_t			result;									// answer (result.address: device addressed)
+} CIVreq_t;
+
+// statistics of the bus (see statsSnapshot), always active
+// (without bigRamAv: 16 bit counters and about half the buckets of twice the width -> approx. 150 instead of 200 bytes)
+constexpr uint8_t  CIVretValCount = CIV_REQ_TIMEOUT+1;	// no of retVal_t values
+#ifdef bigRamAv
+	typedef uint32_t CIVcount_t;
+	constexpr uint8_t  CIVhistShift   = 1;		// bucket 0: 0us, bucket n: 2^(n-1) .. 2^n-1 us
+	constexpr uint8_t  CIVhistBuckets = 20;		// the last one: 262ms and longer
+#else
+	typedef uint16_t CIVcount_t;						// the counters stop at their maximum
+	constexpr uint8_t  CIVhistShift   = 2;		// bucket 0: 0us, bucket n: 4^(n-1) .. 4^n-1 us
+	constexpr uint8_t  CIVhistBuckets = 11;		// the last one: 262ms and longer
+#endif
+
+// histogram of durations (logarithmic buckets)
+typedef struct {
+	CIVcount_t		bucket[CIVhistBuckets];
+	unsigned long	max;											// [us]
+} CIVhist_t;
+
+// counters of a registered device (the same index as its mailbox)
+typedef struct {
+	uint8_t				address;									// CIV_ADDR_NONE: not in use
+	CIVcount_t		frames;										// messages received
+	CIVcount_t		nok;											// CIV_NOK received
+	CIVcount_t		reqTimeouts;							// requests without an answer in time (each attempt)
+} CIVaddrStats_t;
+
+typedef struct {
+	CIVcount_t		rxRetVal[CIVretValCount];	// messages received (CIV_NO_MSG: incomplete frames discarded)
+	CIVcount_t		txRetVal[CIVretValCount];	// results of writeMsg and writeMsgAsync
+	CIVcount_t		otherFrames;							// messages of devices not registered
+	CIVaddrStats_t	device[CIVmailboxCount];
+	CIVhist_t			rxTime;										// duration of readMsgRaw/readMsg, if a message has been received
+	CIVhist_t			txTime;										// duration of writeMsg
+	CIVhist_t			reqLatency;								// requestMsg -> answer
+} CIVstats_t;
+
 // length of Cmd + Subcommands; 
 // default: 1; if the command is in this list: 2
-// 0x1A may have 4 bytes (if cmd is 0x1A+0x05). This has to be covered extra in source code, since this is
-// currently (Jan 2021) the only 4 byte command ...
+// commands with further levels (e.g. 0x1A 0x05 + 2 byte item no.) are defined in CIV_HDR_RULES
 
 constexpr uint8_t CIV_C_LENGTH_2[]  {0x07,0x0E,0x13,0x14,0x15,0x16,0x19,0x1A,0x1B,0x1C,0x1E,0x21,0x27};
 
+// rule for the length of the header (Cmd + Subcommands) of a multi level command
+typedef struct {
+	uint8_t	cmd;
+	uint8_t	sub;																// CIV_SUB_ANY: all other subcommands of cmd
+	uint8_t	hdrLength;													// Cmd + Subcommands [bytes]
+} CIVhdrRule_t;
+
+constexpr uint8_t CIV_SUB_ANY = 0xFF;
+
+constexpr CIVhdrRule_t CIV_HDR_RULES[] {
+	{0x1A,0x00,4},															// memory contents	 + 2 bytes memory channel
+	{0x1A,0x01,4},															// band stacking reg.+ band + register code
+	{0x1A,0x05,4},															// settings					 + 2 bytes item no.
+	{0x1A,CIV_SUB_ANY,2},
+	{0x27,0x00,3},															// scope wave data	 + main/sub
+	{0x27,CIV_SUB_ANY,2}
+};
+
+// header table: 2 bits per command (packed, 64 bytes), generated at compile time from the lists above:
+//	 0: 1 byte, 1: 2 bytes (Cmd + Subcommand), 3: multi level -> see CIV_HDR_RULES
+constexpr uint8_t CIV_HDR_1		= 0;
+constexpr uint8_t CIV_HDR_2		= 1;
+constexpr uint8_t CIV_HDR_RULE	= 3;
+
+constexpr bool civHdrInRules(const uint8_t cmd, const uint8_t idx) {
+	return (idx<sizeof(CIV_HDR_RULES)/sizeof(CIVhdrRule_t)) &&
+				 ((CIV_HDR_RULES[idx].cmd==cmd) || civHdrInRules(cmd,idx+1));
+}
+constexpr bool civHdrInLength2(const uint8_t cmd, const uint8_t idx) {
+	return (idx<sizeof(CIV_C_LENGTH_2)) && ((CIV_C_LENGTH_2[idx]==cmd) || civHdrInLength2(cmd,idx+1));
+}
+constexpr uint8_t civHdrClass(const uint8_t cmd) {
+	return civHdrInRules(cmd,0) ? CIV_HDR_RULE : (civHdrInLength2(cmd,0) ? CIV_HDR_2 : CIV_HDR_1);
+}
+
+#define CIV_HDR_B(c)		uint8_t( civHdrClass((c))         | (civHdrClass((c)+1)<<2) | \
+																(civHdrClass((c)+2)<<4) | (civHdrClass((c)+3)<<6))
+#define CIV_HDR_B4(c)		CIV_HDR_B(c),CIV_HDR_B((c)+4),CIV_HDR_B((c)+8),CIV_HDR_B((c)+12)
+#define CIV_HDR_B16(c)	CIV_HDR_B4(c),CIV_HDR_B4((c)+16),CIV_HDR_B4((c)+32),CIV_HDR_B4((c)+48)
+
+constexpr uint8_t CIV_HDR_TABLE[64] {CIV_HDR_B16(0),CIV_HDR_B16(64),CIV_HDR_B16(128),CIV_HDR_B16(192)};
+
+#undef CIV_HDR_B16
+#undef CIV_HDR_B4
+#undef CIV_HDR_B
+
 
 	
 // CI-V (default-)addresses common to all ICOM radios on the bus:
@@ -172,37 +523,193 @@ constexpr uint8_t C_START  = 0xFE;
 constexpr uint8_t C_STOP   = 0xFD;
 constexpr uint8_t C_OK     = 0xFB;
 constexpr uint8_t C_NOK    = 0xFA;
+constexpr uint8_t C_JAM    = 0xFC;		// jammer code, sent by a device which detected a collision
+
+
+// receive state machine of the CIV bus; collects exactly one frame (FE FE .. FD) byte by byte.
+// The state and the partially received frame survive between the calls, i.e. the bytes can be fed
+// whenever they are available - there is no need to wait for the complete frame.
+// The class has no dependency to the serial interface and can therefore be fed from anywhere
+// (e.g. from a test program on a Linux host).
+// An unexpected start byte within a frame (e.g. after a collision) is taken as the start of the next frame.
+class CIVframer {
+
+public:
+
+	CIVframer();
+
+	void		reset();														// discard the bytes received so far
+	bool		collect(const uint8_t inByte);			// returns true, if a complete frame is in rxBuffer
+	size_t	collect(const uint8_t buf[], const size_t len);	// bulk: returns the no of bytes consumed,
+																							// stops after a complete frame (state==CIV_stop)
+	bool		busy();															// a frame has been started, but is not complete yet
+
+	CIV_State_t			state;
+	uint8_t					rxBuffer[CIV_BUFFERSIZE];		// rxBuffer[0]: no of bytes received
 
+	unsigned long		ts_lastByte;								// timestamp [us] of the last byte received
+
+	bool						ownFrames;									// if true, the frames sent by the master (i.e. the echo
+																							// of the own commands) are accepted as well
+
+	const uint8_t		*addrFilter;								// bitmap of the source addresses accepted (NULL: all);
+																							// other frames are discarded at the source address already
+
+private:
+
+	bool		step(const uint8_t inByte);					// state machine (collect without timestamp)
+
+}; // end class CIVframer
+
+// size of the chunk read at once from interfaces with bulk access (Transport::hasReadBuf, e.g. on the host)
+constexpr uint16_t CIVrxChunkSize = 256;
+
+
+// number of frames which can be stored in CIVrxRing (must be a power of 2; one element is always
+// used for the frame currently being received)
+#ifdef bigRamAv
+	constexpr uint8_t CIVrxRingSize = 8;
+#else
+	constexpr uint8_t CIVrxRingSize = 2;
+#endif
+
+// receive ringbuffer, lock-free for exactly one producer and one consumer.
+// The producer (UART ISR, BT callback or a reader thread on the host) pushes the bytes as they arrive,
+// the frames are assembled directly in the ringbuffer elements.
+// The consumer (CIV::readMsgRaw) takes the completed frames only - without any further copy.
+class CIVrxRing {
+
+public:
+
+	CIVrxRing();
+
+	//::::::::::::: producer side (ISR, callback, thread)
+	void		push(const uint8_t inByte);
+	void		push(const uint8_t buf[], const size_t len);
+	bool		busy();															// a frame is currently being received
+
+	//::::::::::::: consumer side, may be called while the producer is running
+	void		setAddrFilter(const uint8_t *addrFilter);	// see CIVframer::addrFilter (a copy is kept)
+	void		setFrameTimeout(const unsigned long t_us);	// see CIVtiming_t
+
+	const uint8_t *front();											// oldest completed frame (rxBuffer format) or NULL
+	void		pop();															// release the oldest completed frame
+	uint8_t	count();														// number of completed frames
+
+	uint16_t	overruns();													// frames lost, because the ringbuffer has been full
+
+private:
+
+	uint8_t	publish(const uint8_t head);				// hand over a completed frame to the consumer
+	bool		accepted(const uint8_t frame[]);		// source address registered (or own frame) ?
+
+	CIVframer				_frame[CIVrxRingSize];
+
+#ifdef CIV_ATOMIC_IDX
+	std::atomic<uint8_t>	_head;									// written by the producer only
+	std::atomic<uint8_t>	_tail;									// written by the consumer only
+	std::atomic<bool>			_busy;									// written by the producer only
+	std::atomic<unsigned long>	_ts_lastByte;			// written by the producer only
+	std::atomic<unsigned long>	_t_usRxFrame;			// written by the consumer only
+	std::atomic<uint16_t>	_overruns;							// written by the producer only
+	std::atomic<bool>			_filterOn;							// written by the consumer only
+	std::atomic<uint8_t>	_addrFilter[32];				// written by the consumer only
+#else
+	volatile uint8_t			_head;
+	volatile uint8_t			_tail;
+	volatile bool					_busy;
+	volatile unsigned long	_ts_lastByte;
+	volatile unsigned long	_t_usRxFrame;
+	volatile uint16_t			_overruns;
+	volatile bool					_filterOn;
+	volatile uint8_t			_addrFilter[32];
+#endif
+
+}; // end class CIVrxRing
+
+
+// trace of the frames on the bus (log_CIV)
+#include "CIVtrace.h"
+
+// capture of the bus traffic into a file (host only)
+#include "CIVcapture.h"
 
 // class definition
-class CIV {
+// CIVbase contains everything, which is independent from the interface in use (transport);
+// the interface dependent part is in the class template CIVbus (CIVbus.h)
+class CIVbase {
 
 public:
 
   // ctor
-  CIV();
+  CIVbase();
 	
 //------------------------------------------------------------------------
 // public member functions
 
-	//::::::::::::: initialisation of the class CIV
-  void    setupp();	 													// only Serial1, Serial2 or AltSoftSerial supported, NO BT!
-  void    setupp(bool ESP_BT);								// if a true is passed to CIV and it's running on an ESP -> BT will be used
-
-  void    setupp(bool ESP_BT,String BTname);	// if a true is passed to CIV and it's running on an ESP -> BT with id BTname will be used
-																							// Note: Pls delete the BT-object in the IC705 pairing menu and perform a new
-																							// pairing every time you change this name - otherwise you won't see 
-																							// this change in the IC705!
-
 //::::::::::::: make the CIV address in use known to CIV
 	void		registerAddr(const uint8_t deviceAddr);
+	/*
+	up to CIVmailboxCount devices can be registered. As soon as at least one address is registered,
+	frames from other (unregistered) devices are discarded by the receiver already at their source address.
+	*/
 
 //::::::::::::: remove a specific CIV address from the known address list
 	void		unregisterAddr(const uint8_t deviceAddr);
 
 //::::::::::::: is a specific address known to CIV ?
-	bool 		isAddrKnown(const uint8_t deviceAddr);
+	bool 		isAddrKnown(const uint8_t deviceAddr)	{return (_addrMap[deviceAddr>>3] & (1<<(deviceAddr&7)))!=0;}
+
 
+	//::::::::::::: timing of the bus, derived from the baudrate in use
+	const CIVtiming_t &timing()													{return _timing;}
+
+	//::::::::::::: 
+	CIVmsgRef		readMsgRef(const uint8_t deviceAddr);
+	/*
+	same as readMsg, but without copying the message: the message is decoded into a slot of CIVresultBuf
+	and stays there, the CIVmsgRef returned is just a view of it. The slot is released by CIVmsgRef::release()
+	or when the CIVmsgRef is destroyed (e.g. at the end of the block), so the CIVmsgRef shouldn't be kept longer
+	than necessary - as long as it exists, the slot can't be used for new messages.
+	e.g.
+		CIVmsgRef msg = civ.readMsgRef(CIV_ADDR_7300);
+		if (msg->retVal==CIV_OK_DAV) frequency = msg->value;
+	*/
+
+	//::::::::::::: behaviour of readMsg, if the buffer is full
+	void		setOverflowPolicy(const CIVoverflow_t policy, const uint8_t quota = 0);
+	/*
+	policy:	see CIVoverflow_t; with CIV_ovfStall (the behaviour of earlier versions), one device whose messages
+					are not fetched stops the reception for all devices.
+	quota:	max. no of messages buffered per device (0: no limit); if a device exceeds its quota, its oldest
+					message is dropped (with CIV_ovfDropNewest the new one)
+	*/
+	const CIVovfCounters_t &overflowCounters()					{return _ovfCounters;}
+
+	//::::::::::::: retransmission of commands after a collision on the bus
+	void		setRetryPolicy(const uint8_t maxAttempts,
+												 const unsigned long t_usMin = t_usBackoffMin, const unsigned long t_usMax = t_usBackoffMax);
+	/*
+	maxAttempts:	max. no of transmissions per frame (1: no retransmission, default)
+	t_usMin/Max:	range of the randomised, exponentially growing waiting time before a retransmission
+	writeMsg retransmits after CIV_BUS_CONFLICT and CIV_BUS_BUSY (waiting in between),
+	writeMsgAsync after CIV_BUS_CONFLICT (the command stays in the queue, writeStatus is CIV_TX_PENDING meanwhile;
+	the other commands of the queue are sent during its waiting time).
+	After CIVjamLimit collisions in a row, the bus is regarded as jammed: no further retransmissions until
+	a command has been sent successfully.
+	*/
+	const CIVretryCounters_t &retryCounters()						{return _retryCounters;}
+	bool		busJammed()																	{return (_conflictsInRow>=CIVjamLimit);}
+
+	//::::::::::::: device specific header lengths of multi level commands (registered devices only)
+	void		setGrammar(const uint8_t deviceAddr, const CIVhdrRule_t rules[], const uint8_t count);
+	/*
+	the rules are checked before CIV_HDR_TABLE / CIV_HDR_RULES, the array has to exist as long as it's in use
+	e.g.
+		constexpr CIVhdrRule_t myRotor[] {{0x31,CIV_SUB_ANY,3}};
+		civ.setGrammar(CIV_ADDR_ROTOR, myRotor, 1);
+	*/
+	uint16_t	droppedMsgs(const uint8_t deviceAddr);	// no of messages lost of a specific device
 
 	//::::::::::::: 
 	CIVresult_t readMsg(const uint8_t deviceAddr);
@@ -214,20 +721,25 @@ public:
 
 	If these messages are not fetched in time by their corresponding SW-instances, there is a certain
 	risk (very small, though), that the buffer gets full.
-		In this case no other message from the CI-V bus will be fetched until this buffer is cleared by calling 
-	readMsg with the proper address.
+		In this case messages are dropped according to the overflow policy (setOverflowPolicy).
 	*/
 
 	//::::::::::::: 
-  CIVresult_t readMsgRaw();
+  CIVresult_t readMsgRaw()								{CIVresult_t CIVresultL; receiveTimed(CIVresultL); return CIVresultL;}
   /*
 	main function to read incoming data
 	can be used independently from writeCmd for asynchronous receiving
-  (takes approx. 4us without data received, 750us if e.g. frequency received)
+  (takes approx. 4us without data received, 750us if e.g. frequency received;
+   on a Linux host approx. 0.1us per frame - see Examples/CIV_HostBenchmark)
+
+	readMsgRaw doesn't wait for the bytes of the bus anymore; it takes only those bytes, which are already
+	available in the serial interface. If a frame has been started, but is not complete yet, CIV_MSG_PENDING
+	is returned and the frame will be continued with the next call.
+	An incomplete frame will be discarded, if no further byte has been received within t_usRxFrame.
 	*/
 
 	//::::::::::::: 
-  CIVresult_t writeMsg (const uint8_t deviceAddr, const uint8_t cmd_body[], const uint8_t cmd_data[],writeMode_t mode);
+  virtual CIVresult_t writeMsg (const uint8_t deviceAddr, const uint8_t cmd_body[], const uint8_t cmd_data[],writeMode_t mode) = 0;
 	/*
   main function to write data to a specific radio
 	CIV_wFast 		in this mode, the time used by this procedure is very short, i.e.
@@ -242,57 +754,281 @@ public:
 
 	CIV_wOn				only used when the radio shall be switched on. In this case, a number of 0xFE will be
 								sent to the radio in order to wake it up. This is necessary according to ICOM's spec.
+
+	A command, which doesn't fit into a frame (CIV_TXBUFFERSIZE), isn't sent at all -> CIV_NOK
+	*/
+
+	//::::::::::::: 
+	CIVtxHandle_t writeMsgAsync (const uint8_t deviceAddr, const uint8_t cmd_body[], const uint8_t cmd_data[],writeMode_t mode,
+															 const CIVprio_t prio = CIV_prioUser);
+	/*
+	same as writeMsg, but without any waiting: the command is put into a queue and a handle is returned
+	immediately (0 if the queue is full or the command is too long).
+	The command is sent as soon as the bus is free, the echo is checked byte by byte as the bytes come in
+	(CIV_wChk only). This is done in the background by readMsg/readMsgRaw, writeStatus or writeAwait.
+	The queue is sent in the order of the priority classes (CIVprio_t), within a class in the order of the calls.
+	A command waiting longer than t_usPrioAging climbs up one class (no starvation of the polling).
+	If the queue is full, a command of a higher class replaces the newest queued command of a lower class
+	(its handle becomes unknown -> CIV_NO_MSG); a command, which is too long, doesn't replace anything.
+	Note: writeMsg doesn't use the queue, i.e. it goes onto the bus immediately (if the bus is free).
+	*/
+
+	const CIVtxLatency_t &txLatency(const CIVprio_t prio)	{return _txLatency[prio];}
+
+	uint8_t	writeStatus (const CIVtxHandle_t handle);
+	/*
+	CIV_TX_PENDING as long as the command is in the queue or its echo is being checked,
+	afterwards the result as in writeMsg: CIV_OK, CIV_BUS_CONFLICT or CIV_HW_FAULT
+	CIV_NO_MSG, if the handle is unknown (invalid, or the result has been overwritten by a newer command)
+	As long as the command is pending, the bus is read as by readMsg (one message, kept in its mailbox).
+	*/
+
+	uint8_t	writeAwait (const CIVtxHandle_t handle);	// same as writeStatus, but waits for the final result
+
+	virtual void	txService() = 0;				// send the queued commands / check the echo (called by readMsgRaw)
+
+	//::::::::::::: requests (commands with an answer), several of them may be outstanding per device
+	CIVreqHandle_t requestMsg (const uint8_t deviceAddr, const uint8_t cmd_body[], const uint8_t cmd_data[],
+														 const unsigned long t_usTimeout = t_usRequest, const uint8_t retries = 1,
+														 const CIVprio_t prio = CIV_prioUser, const writeMode_t mode = CIV_wChk);
+	/*
+	the command is sent via writeMsgAsync (mode, e.g. CIV_wFast for cyclic polls: the answer itself shows,
+	that the query has got onto the bus) and registered in a table of pending requests (CIVreqTableSize);
+	returns a handle (0, if the table or the queue is full).
+	Incoming messages (addressed to the master) are matched against the requests of their device, which
+	are already on the bus:
+		data (CIV_OK_DAV):	the oldest request with the same command/subcommand(s)
+		CIV_OK / CIV_NOK:		the oldest frame sent to the device, which is still waiting for its answer
+												(the devices answer in the order of the frames, incl. writeMsg/writeMsgAsync)
+	The message is delivered to the mailbox of its device (readMsg) as before, a copy is kept in the request.
+	The deadline starts, when the command has been sent successfully (not while it's waiting in the queue):
+	if there's no answer within t_usTimeout [us], the command is sent again (up to retries times).
+	An answer coming in later than t_usTimeout may be assigned to the next frame of the device.
+	cmd_body and cmd_data must exist until the request is finished (e.g. the constants of CIVcmds.h).
+	e.g.
+		CIVreqHandle_t fReq = civ.requestMsg(CIV_ADDR_705, CIV_C_F_READ, CIV_D_NIX);
+		CIVreqHandle_t mReq = civ.requestMsg(CIV_ADDR_705, CIV_C_MOD_READ, CIV_D_NIX);	// both in flight
+	*/
+
+	uint8_t	requestStatus (const CIVreqHandle_t handle);
+	/*
+	CIV_TX_PENDING as long as the answer is outstanding,
+	afterwards retVal of the answer (CIV_OK, CIV_OK_DAV, CIV_NOK), CIV_REQ_TIMEOUT,
+	or the error of the transmission (CIV_BUS_CONFLICT, CIV_HW_FAULT)
+	CIV_NO_MSG, if the handle is unknown (invalid, or the request has been overwritten by a newer one)
+	*/
+
+	const CIVresult_t &requestResult (const CIVreqHandle_t handle);	// answer (CIV_NO_MSG, if not available)
+	uint8_t	requestsPending (const uint8_t deviceAddr);					// no of outstanding requests of the device
+
+	void		setCoalesceWindow (const unsigned long t_us)			{_reqCoalesceWindow = t_us;}
+	uint16_t	requestsCoalesced()																{return _reqCoalesced;}
+	/*
+	Queries (commands without data) of several callers are merged: if the same query (device + command) is
+	already pending, or has been answered less than t_us ago (default t_usCoalesce, 0: pending only),
+	requestMsg doesn't send it again, but returns the handle of the existing request.
+	All callers share this request (and its answer); requestsCoalesced counts the transmissions saved.
+	*/
+
+	//::::::::::::: statistics (counters and histograms, always active)
+	void		statsSnapshot(CIVstats_t &snapshot, const bool reset = false);
+	void		statsReset();
+	static unsigned long statsPercentile(const CIVhist_t &hist, const uint8_t percent);
+	/*
+	statsSnapshot copies the statistics collected so far into snapshot (see CIVstats_t), with reset = true
+	the counting starts again afterwards. The counters are per retVal (receiving and writing) and per
+	registered device; the durations are collected in histograms with logarithmic buckets.
+	statsPercentile: the upper limit [us] of the bucket, which contains the percentile (e.g. 99; at most max), 0 if empty.
+	e.g.
+		CIVstats_t s;
+		civ.statsSnapshot(s, true);
+		Serial.println(CIV::statsPercentile(s.reqLatency, 95));
+	Note: incomplete frames discarded by CIVrxRing (useRxRing) are not counted.
 	*/
 
 	//::::::::::::: logging
 
+	void logClear();
+	void logNewEntry(const uint8_t msg[], const CIVtraceEvt_t evt, const uint8_t state) {
+#ifdef log_CIV
+		_trace.add(evt,state,msg);
+#endif
+#ifdef useHost
+		if (_capture!=NULL) _capture->add(evt,state,msg);
+#endif
+		(void)msg; (void)evt; (void)state;
+	}
+	void logDisplay();																// prints and removes all entries
+
+	#ifdef useHost
+	void				setCapture(CIVcapture *capture)				{_capture = capture;}
+	/*
+	every frame (RX and TX, as in the trace) is recorded into the capture file in addition (NULL: stop);
+	see CIVcapture.h, replay by CIVreplayTransport
+	*/
+	#endif
+
 	#ifdef log_CIV
-		#ifdef bigRamAv
-			#define logMaxEntries 40
-			#define logMsgLength  25
-			#define logNameLength 5
-		#else
-			#define logMaxEntries 18
-			#define logMsgLength  20
-			#define logNameLength 5
-		#endif
-
-		static uint8_t   logEntry;
-		static uint8_t   logBuffer	[logMaxEntries][logMsgLength];
-    static uint8_t   logBufferState[logMaxEntries];
-		static char      logBufferName	[logMaxEntries][logNameLength];
-  #endif
-
-
-  void logClear();
-	void logNewEntry(uint8_t msg[],const char name[],const uint8_t state);
-	void logNewInRing (uint8_t inByte);
-	void logDisplayLine(uint8_t lineNo);
-	void logDisplay();
+	CIVtrace		&trace()																{return _trace;}
+	/*
+	the entries of the log (timestamp, sequence number, event, retVal and the complete frame) are
+	recorded in binary form; they can be read out raw (read) or as text (format, print), e.g.
+		char line[CIVtraceLineLen];
+		while (civ.trace().format(line,sizeof(line))>0) mqttPublish(line);
+	*/
+	#endif
 
-private:
+protected:
 //------------------------------------------------------------------------
-// private methods
-
-	// low level serial access
-	uint8_t 	serAvailable();
-	uint8_t 	serRead();
-	void 			serWrite(uint8_t ch);
-  void 			serflushOutput();
+// protected methods (used by CIVbus)
+
+	// readMsgRaw, but the message is decoded directly into CIVresultL (e.g. a slot of CIVresultBuf)
+	virtual void receive(CIVresult_t &CIVresultL) = 0;
+	void				receiveTimed(CIVresult_t &CIVresultL) {		// receive + duration into the statistics
+		unsigned long ts = micros();
+		receive(CIVresultL);
+		if (CIVresultL.retVal<=CIV_NOK) statsTime(_stats.rxTime, micros()-ts);
+	}
+
+	// evaluation of a complete frame (as collected by CIVframer)
+	void				decodeMsg(const uint8_t rxBuffer[], CIVresult_t &CIVresultL);
+	uint8_t			headerLength(const uint8_t rxBuffer[]);	// length of Cmd + Subcommands of the frame
+
+	// take the next frame out of the receive ringbuffer (receive, if useRxRing is in use)
+	void				readRing(CIVresult_t &CIVresultL);
+
+	// check of the own command's echo in the receive ringbuffer
+	CIVresult_t	checkEcho(const uint8_t txBuffer[], CIVresult_t &CIVresultL);
+
+	// build the complete frame in txBuffer (returns false, if it doesn't fit into maxLength)
+	bool				buildMsg(uint8_t txBuffer[], const uint8_t maxLength,
+											 const uint8_t deviceAddr, const uint8_t cmd_body[], const uint8_t cmd_data[]);
+	// complete frame out of the cache (NULL, if the command can't be cached -> buildMsg)
+	const uint8_t	*cachedMsg(const uint8_t deviceAddr, const uint8_t cmd_body[], const uint8_t cmd_data[]);
+
+	// slots of CIVresultBuf
+	CIVmsgSlot_t	*freeSlot();												// NULL, if all slots are in use
+	void				keepMsg(CIVmsgSlot_t *slot);					// put the message into the mailbox of its device
+	CIVmailbox_t	*mailbox(const uint8_t deviceAddr);	// NULL, if the device isn't registered
+	const uint8_t	*addrFilter()													// for CIVframer (NULL: nothing registered -> accept all)
+									{return (_addrCount>0) ? _addrMap : NULL;}
+	bool				canFetch();														// a new message can be read from the bus
+	void				dropMsg(CIVmailbox_t *mbx, const uint8_t prev);	// remove the message after prev (or the oldest)
+	uint8_t			fetchMsg();														// receive the next message and keep it, if possible
+
+	// queue of writeMsgAsync
+	bool				txEcho(const uint8_t inByte);					// echo byte of the command on the bus ?
+	bool				txEchoFrame(const uint8_t frame[]);		// echo frame of the command on the bus ?
+	CIVtxHandle_t	txEnqueue(const uint8_t deviceAddr, const uint8_t cmd_body[], const uint8_t cmd_data[],
+													const writeMode_t mode, const CIVprio_t prio);	// writeMsgAsync without sending
+	void				txDone(CIVtxSlot_t &slot, const uint8_t retVal);
+	bool				txRetry(const uint8_t retVal, const uint8_t attempts);	// bookkeeping; true: send it again
+	unsigned long	txBackoff(const uint8_t attempts);		// waiting time [us] before the next attempt
+	bool				txJam(const uint8_t frame[], const uint8_t len);	// jammer code in the frame ?
+
+	// table of requests
+	void				reqMatch(const CIVresult_t &msg, const uint8_t dstAddr);	// answer to a pending request ?
+	void				reqService();													// deadlines and retransmissions
+	void				reqSend(CIVreq_t &req);								// (re)queue the command of the request
+	void				reqSent(const CIVtxHandle_t txHandle);	// the command of a request is on the bus
+	void				expectAnswer(const uint8_t deviceAddr, const CIVtxHandle_t txHandle);	// frame sent
+	void				expectDrop(const uint8_t idx);
+	void				expectPurge();												// frames, which won't get an answer any more
+	CIVreq_t		*reqSlot(const CIVreqHandle_t handle);
+	CIVreq_t		*reqShared(const uint8_t deviceAddr, const uint8_t cmd_body[]);	// same query pending/just answered
+	// timing derived from the baudrate
+	void				setTiming(const unsigned long baudrate);
+	uint16_t		echoLoops(const uint8_t len)					// [t_usLoop] waiting for the echo of len bytes
+									{return (len*_timing.t_usByte + t_usTurnaround)/t_usLoop + 1;}
+
+	void				txWait(const unsigned long t_us);			// blocking wait (also > 16ms)
+	CIVtxSlot_t	*txSlot(const CIVtxHandle_t handle);
+	CIVtxSlot_t	*txNext();														// next command to be sent (priority + aging)
+
+	// statistics
+	static void	statsCount(CIVcount_t &counter)				{if (counter!=CIVcount_t(~0)) counter++;}
+	static void	statsTime(CIVhist_t &hist, const unsigned long t_us);
+	void				statsFrame(const CIVresult_t &msg);		// counters of a message received
 
 //------------------------------------------------------------------------
-// private variables
+// protected variables
 
-	uint8_t         rxBuffer[CIV_BUFFERSIZE];
+	CIVframer				_rxFramer;
+	CIVrxRing				*_rxRing = NULL;
+	CIVtiming_t			_timing;
+#ifdef log_CIV
+	CIVtrace				_trace;
+#endif
+#ifdef useHost
+	CIVcapture			*_capture = NULL;
+#endif
 
-	CIVresult_t 		CIVresultBuf[CIVresultBufSize];
-	uint8_t 		 		CIVresultBufIdx; 
+	CIVtxSlot_t			_txQueue[CIVtxQueueSize];
+	CIVtxSlot_t			*_txActive = NULL;			// the command currently on the bus
+	CIVtxHandle_t		_txHandle = 0;					// last handle assigned
+	CIVtxLatency_t	_txLatency[CIVprioCount];
+
+	CIVreq_t				_reqTable[CIVreqTableSize];
+	CIVreqHandle_t	_reqHandle = 0;					// last handle assigned
+	uint8_t					_reqPending = 0;				// no of pending requests
+	unsigned long		_reqCoalesceWindow = t_usCoalesce;
+	uint16_t				_reqCoalesced = 0;			// requests served by another one
+	CIVexpect_t			_expect[CIVexpectSize];	// frames waiting for an answer, oldest first
+	uint8_t					_expectCount = 0;
+
+	uint8_t					_retryMax = 1;					// max. no of transmissions per frame
+	unsigned long		_retryMin = t_usBackoffMin;
+	unsigned long		_retryMaxWait = t_usBackoffMax;
+	uint8_t					_conflictsInRow = 0;
+	uint32_t				_rnd = 0;								// state of the random generator (xorshift)
+	CIVretryCounters_t	_retryCounters = {0,0,0,0,0};
+
+	uint8_t					_txCache[CIVtxCacheSize][CIVtxCacheMsgSize];	// [0]: length of the frame, 0: unused
+	uint8_t					_txCacheNext = 0;				// entry to be replaced next
+
+	CIVmsgSlot_t 		CIVresultBuf[CIVresultBufSize+1];	// +1: spare for receiving, if all the others are full
+	uint8_t					_stored = 0;						// no of messages in the mailboxes
+
+	CIVoverflow_t		_ovfPolicy = CIV_ovfDropOldest;
+	uint8_t					_ovfQuota = 0;					// max. no of messages per device (0: no limit)
+	CIVovfCounters_t	_ovfCounters = {0,0,0,0};
+
+	CIVstats_t			_stats;
+
+	CIVmailbox_t		_mailbox[CIVmailboxCount];
+	const CIVhdrRule_t	*_hdrRules[CIVmailboxCount];	// device specific grammar (setGrammar)
+	uint8_t					_hdrRuleCount[CIVmailboxCount];
+	uint8_t					_addrMap[32];						// bitmap of the registered addresses (1 bit per address)
+	uint8_t					_addrCount = 0;					// no of registered addresses
+#ifdef bigRamAv
+	uint8_t					_addrMailbox[256];			// address -> index of the mailbox (O(1) routing)
+#endif
 
-	uint8_t		 			knownAddress[knownAddrListSize];
+}; // end class CIVbase
 
-	bool						_ESP_BT = false;
 
-}; // end class CIV
+// conversion of BCD coded fields
+#include "CIVbcd.h"
+
+// interfaces (transports) for CIVbus
+#include "CIVtransport.h"
+
+// interface dependent part of CIV
+#include "CIVbus.h"
+
+// CIV with the default interface of the board
+#if defined(useAltSoftSerial)
+	typedef CIVbus<CIValtSoftTransport>	CIV;
+#elif defined(useSerial_1) || (defined(useSerial_2) && !defined(useBTonly))
+	typedef CIVbus<CIVserialTransport>		CIV;
+#elif defined(useBTonly)
+	typedef CIVbus<CIVbtTransport>				CIV;
+#elif defined(useHost)
+	typedef CIVbus<CIVmemTransport>			CIV;
+#endif
+
+// optional I/O task (ESP32, Linux host)
+#include "CIVio.h"
 
 
 #endif
@@ -0,0 +1,135 @@
+/*
+	CIVtrace.cpp - Library for communication via ICOM's CI-V bus
+	Released into the public domain
+
+	Trace of the frames on the bus (see CIVtrace.h)
+*/
+
+
+#if defined(ARDUINO)
+	#include <Arduino.h>
+#endif
+
+#include <stdio.h>
+#include "CIVcmds.h"
+#include "CIVmaster.h"
+
+//ctor = constructor
+CIVtrace::CIVtrace() : _head(0), _tail(0), _seq(0), _lost(0)
+{
+}
+
+//:::::::::
+void CIVtrace::add(const CIVtraceEvt_t evt, const uint8_t retVal, const uint8_t frame[]) {
+
+// time critical: copying only, the formatting is done by format/print
+
+	uint8_t hdr[CIVtraceHdrLen];
+	unsigned long ts = micros();
+	uint8_t len = frame[0];
+
+	if (uint16_t(CIVtraceHdrLen+len)>CIVtraceSize) len = uint8_t(CIVtraceSize-CIVtraceHdrLen);
+
+	while (uint16_t(CIVtraceSize-used()) < CIVtraceHdrLen+len) {	// full -> overwrite the oldest records
+		_tail += CIVtraceHdrLen + _buf[_tail & (CIVtraceSize-1)];
+		_lost++;
+	}
+
+	hdr[0] = len;
+	hdr[1] = uint8_t(_seq);			hdr[2] = uint8_t(_seq>>8);
+	hdr[3] = uint8_t(ts);				hdr[4] = uint8_t(ts>>8);
+	hdr[5] = uint8_t(ts>>16);		hdr[6] = uint8_t(ts>>24);
+	hdr[7] = evt;
+	hdr[8] = retVal;
+	_seq++;
+
+	put(hdr, CIVtraceHdrLen);
+	put(&frame[1], len);
+
+}
+
+//:::::::::
+bool CIVtrace::read(CIVtraceRec_t &rec, uint8_t frame[], const uint8_t maxLen) {
+
+	uint8_t hdr[CIVtraceHdrLen];
+
+	if (used()==0) return false;
+
+	get(hdr, CIVtraceHdrLen);
+	rec.len			= hdr[0];
+	rec.seq			= hdr[1] | (uint16_t(hdr[2])<<8);
+	rec.ts			= hdr[3] | (uint32_t(hdr[4])<<8) | (uint32_t(hdr[5])<<16) | (uint32_t(hdr[6])<<24);
+	rec.evt			= CIVtraceEvt_t(hdr[7]);
+	rec.retVal	= hdr[8];
+
+	if (rec.len<=maxLen)
+		get(frame, rec.len);
+	else {																							// cut, the rest is skipped
+		get(frame, maxLen);
+		_tail += rec.len-maxLen;
+	}
+	return true;
+
+}
+
+//:::::::::
+size_t CIVtrace::format(char buf[], const size_t maxLen) {
+
+// e.g. "   12    1843211 RX   1 : FE FE E0 A2 00 00 50 34 07 00 FD"
+
+	static const char hex[] = "0123456789ABCDEF";
+	CIVtraceRec_t rec;
+	uint8_t frame[CIV_BUFFERSIZE-1];										// without the length byte
+	size_t pos;
+	uint8_t idx;
+
+	if ((maxLen==0) || !read(rec, frame, sizeof(frame))) return 0;
+
+	pos = snprintf(buf, maxLen, "%5u %10lu %-4s %u :",
+								 (unsigned int)rec.seq, (unsigned long)rec.ts, evtName(rec.evt), (unsigned int)rec.retVal);
+	if (pos>=maxLen) return maxLen-1;
+
+	for (idx=0; (idx<rec.len) && (idx<sizeof(frame)) && (pos+3<maxLen); idx++) {
+		buf[pos++] = ' ';
+		buf[pos++] = hex[frame[idx]>>4];
+		buf[pos++] = hex[frame[idx]&0x0F];
+	}
+	buf[pos] = '\0';
+	return pos;
+
+}
+
+//:::::::::
+const char *CIVtrace::evtName(const CIVtraceEvt_t evt) {
+
+	static const char *const names[CIV_trEvtCount] = {"RX","TXok","TX_C","TX_S","CHK"};
+
+	return (evt<CIV_trEvtCount) ? names[evt] : "?";
+
+}
+
+//:::::::::
+void CIVtrace::put(const uint8_t src[], const uint16_t len) {
+
+	uint16_t pos = _head & (CIVtraceSize-1);
+	uint16_t part = CIVtraceSize-pos;
+
+	if (part>len) part = len;
+	memcpy(&_buf[pos], src, part);											// up to the end of the buffer
+	memcpy(_buf, &src[part], len-part);									// the rest from the beginning
+	_head += len;
+
+}
+
+//:::::::::
+void CIVtrace::get(uint8_t dst[], const uint16_t len) {
+
+	uint16_t pos = _tail & (CIVtraceSize-1);
+	uint16_t part = CIVtraceSize-pos;
+
+	if (part>len) part = len;
+	memcpy(dst, &_buf[pos], part);
+	memcpy(&dst[part], _buf, len-part);
+	_tail += len;
+
+}
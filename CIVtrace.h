@@ -0,0 +1,96 @@
+/*
+	CIVtrace.h - Library for communication via ICOM's CI-V bus
+	Released into the public domain
+
+	Trace of the frames on the bus (log_CIV): a ringbuffer of variable length binary records.
+	Recording only copies the frame as it is (no formatting, no truncation), the formatting into
+	text is done later and outside of the time critical parts (format, print).
+
+	record in the ringbuffer:
+		[0]			length of the frame (n)
+		[1..2]	sequence number (a gap shows, that records have been overwritten)
+		[3..6]	timestamp [us] (micros())
+		[7]			event (CIVtraceEvt_t, includes the direction)
+		[8]			retVal
+		[9..]		the frame (n bytes, without the length byte)
+	If the ringbuffer is full, the oldest records are overwritten.
+
+	e.g.
+		civ.trace().print(Serial);						// prints and removes all records
+		while (civ.trace().format(line,sizeof(line))>0) ... // one line per record into line
+
+	This file will be included by CIVmaster.h automatically.
+*/
+#ifndef CIVtrace_h
+#define CIVtrace_h
+
+
+// size of the ringbuffer [bytes] (must be a power of 2)
+#ifdef bigRamAv
+	constexpr uint16_t CIVtraceSize = 2048;
+#else
+	constexpr uint16_t CIVtraceSize = 256;
+#endif
+
+constexpr uint8_t  CIVtraceHdrLen  = 9;										// record without the frame
+constexpr uint16_t CIVtraceLineLen = 32 + 3*CIV_BUFFERSIZE;	// max. length of a formatted record
+
+// what happened to the frame
+enum CIVtraceEvt_t:uint8_t {
+	CIV_trRX = 0,					// received (incl. timeout of an incomplete frame)
+	CIV_trTXok,						// sent
+	CIV_trTXconflict,			// sent, but the echo has been corrupted
+	CIV_trTXshort,				// sent, but no echo at all
+	CIV_trTXbusy,					// not sent, bus busy
+	CIV_trEvtCount
+};
+
+// one record, as read out of the ringbuffer
+typedef struct {
+	uint16_t				seq;
+	unsigned long		ts;
+	CIVtraceEvt_t		evt;
+	uint8_t					retVal;
+	uint8_t					len;												// length of the frame (also if it has been cut by read)
+} CIVtraceRec_t;
+
+class CIVtrace {
+
+public:
+
+	CIVtrace();
+
+	//::::::::::::: recording (frame[0]: length of the frame)
+	void		add(const CIVtraceEvt_t evt, const uint8_t retVal, const uint8_t frame[]);
+
+	//::::::::::::: read out (removes the oldest record)
+	bool		read(CIVtraceRec_t &rec, uint8_t frame[], const uint8_t maxLen);
+	size_t	format(char buf[], const size_t maxLen);	// one line of text; 0: trace is empty
+
+	template <class Out>
+	void		print(Out &out) {												// all records, e.g. to Serial
+		char line[CIVtraceLineLen];
+		while (format(line,sizeof(line))>0) out.println(line);
+	}
+
+	void		clear()																	{_tail = _head;}
+	uint16_t	used()																{return uint16_t(_head-_tail);}	// [bytes]
+	uint16_t	lost()																{return _lost;}		// records overwritten
+
+	static const char *evtName(const CIVtraceEvt_t evt);
+
+private:
+
+	void		put(const uint8_t src[], const uint16_t len);
+	void		get(uint8_t dst[], const uint16_t len);
+
+	uint8_t		_buf[CIVtraceSize];
+	uint16_t	_head;													// free running, position = & (CIVtraceSize-1)
+	uint16_t	_tail;
+	uint16_t	_seq;
+	uint16_t	_lost;
+
+}; // end class CIVtrace
+
+
+#endif
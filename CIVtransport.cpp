@@ -0,0 +1,372 @@
+/*
+	CIVtransport.cpp - Library for communication via ICOM's CI-V bus
+	Released into the public domain
+
+	Transports of the Linux host (see CIVtransport.h); the transports of the Arduino boards
+	are completely defined in CIVtransport.h
+*/
+
+#if !defined(ARDUINO)
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+
+#include "CIVmaster.h"
+
+#ifdef useHost
+
+//------------------------------------------------------------------------
+// class CIVmemTransport
+
+//ctor = constructor
+CIVmemTransport::CIVmemTransport() : _echo(true)
+{
+}
+
+int CIVmemTransport::available() {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return (int)_rx.size();
+}
+
+int CIVmemTransport::read() {
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (_rx.empty()) return -1;
+	uint8_t ch = _rx.front(); _rx.pop_front();
+	return ch;
+}
+
+size_t CIVmemTransport::readBuf(uint8_t buf[], size_t maxLen) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	size_t len = (_rx.size()<maxLen) ? _rx.size() : maxLen;
+
+	std::copy(_rx.begin(), _rx.begin()+len, buf);
+	_rx.erase(_rx.begin(), _rx.begin()+len);
+	return len;
+}
+
+void CIVmemTransport::write(uint8_t ch) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	_tx.push_back(ch);
+	if (_echo) {														// one-wire bus -> own bytes are received as well
+		_rx.push_back(ch);
+		_rxEvent.notify_all();
+	}
+}
+
+void CIVmemTransport::write(const uint8_t buf[], size_t len) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	_tx.insert(_tx.end(),buf,buf+len);
+	if (_echo) {
+		_rx.insert(_rx.end(),buf,buf+len);
+		_rxEvent.notify_all();
+	}
+}
+
+//::::::::: wait for received bytes and read them
+size_t CIVmemTransport::readWait(uint8_t buf[], size_t maxLen, unsigned long timeout) {
+	std::unique_lock<std::mutex> lock(_mutex);
+	size_t len = 0;
+
+	_rxEvent.wait_for(lock, std::chrono::microseconds(timeout), [this]() {return !_rx.empty();});
+	while ((len<maxLen) && (!_rx.empty())) {buf[len++] = _rx.front(); _rx.pop_front();}
+	return len;
+}
+
+//::::::::: bytes received from the bus
+void CIVmemTransport::feed(const uint8_t buf[], size_t len) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	_rx.insert(_rx.end(),buf,buf+len);
+	_rxEvent.notify_all();
+}
+
+//::::::::: bytes sent to the bus
+size_t CIVmemTransport::fetch(uint8_t buf[], size_t maxLen) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	size_t len = 0;
+	while ((len<maxLen) && (!_tx.empty())) {buf[len++] = _tx.front(); _tx.pop_front();}
+	return len;
+}
+
+void CIVmemTransport::setEcho(bool echo) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	_echo = echo;
+}
+
+
+//------------------------------------------------------------------------
+// class CIVptyTransport
+
+//ctor = constructor
+CIVptyTransport::CIVptyTransport() : _fd(-1), _echo(true), _rxIdx(0), _rxLen(0)
+{
+	_slaveName[0] = '\0';
+}
+
+CIVptyTransport::~CIVptyTransport() {
+	close();
+}
+
+//::::::::: open an existing tty/pty (raw mode, non blocking)
+bool CIVptyTransport::open(const char path[]) {
+	struct termios tio;
+
+	close();
+	_fd = ::open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (_fd<0) return false;
+
+	if (tcgetattr(_fd,&tio)==0) {
+		cfmakeraw(&tio);
+		tio.c_cflag |= CLOCAL | CREAD;
+		tcsetattr(_fd,TCSANOW,&tio);
+	}
+	return true;
+}
+
+//::::::::: create a new pty, the master side is used by this transport
+bool CIVptyTransport::openPty() {
+	struct termios tio;
+	const char *name;
+
+	close();
+	_fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (_fd<0) return false;
+
+	if ((grantpt(_fd)!=0) || (unlockpt(_fd)!=0) || ((name=ptsname(_fd))==NULL)) {
+		close(); return false;
+	}
+	strncpy(_slaveName,name,sizeof(_slaveName)-1);
+	_slaveName[sizeof(_slaveName)-1] = '\0';
+
+	if (tcgetattr(_fd,&tio)==0) {
+		cfmakeraw(&tio);
+		tcsetattr(_fd,TCSANOW,&tio);
+	}
+	return true;
+}
+
+const char *CIVptyTransport::slaveName() {
+	return _slaveName;
+}
+
+void CIVptyTransport::close() {
+	if (_fd>=0) ::close(_fd);
+	_fd = -1;
+	_slaveName[0] = '\0';
+	_rxIdx = 0; _rxLen = 0;
+}
+
+//::::::::: set the baudrate (ignored by a pty)
+void CIVptyTransport::begin(unsigned long baudrate) {
+	struct termios tio;
+	speed_t speed;
+
+	if ((_fd<0) || (tcgetattr(_fd,&tio)!=0)) return;
+
+	switch (baudrate) {
+		case   4800: speed = B4800;		break;
+		case   9600: speed = B9600;		break;
+		case  38400: speed = B38400;	break;
+		case  57600: speed = B57600;	break;
+		case 115200: speed = B115200;	break;
+		default:		 speed = B19200;	break;
+	}
+	cfsetispeed(&tio,speed);
+	cfsetospeed(&tio,speed);
+	tcsetattr(_fd,TCSANOW,&tio);
+}
+
+int CIVptyTransport::available() {
+	std::unique_lock<std::mutex> lock(_mutex);
+	if (_rxIdx==_rxLen) fill(lock,0);
+	return _rxLen-_rxIdx;
+}
+
+int CIVptyTransport::read() {
+	std::unique_lock<std::mutex> lock(_mutex);
+	if (_rxIdx==_rxLen) fill(lock,0);
+	return (_rxIdx<_rxLen) ? _rxBuf[_rxIdx++] : -1;
+}
+
+size_t CIVptyTransport::readBuf(uint8_t buf[], size_t maxLen) {
+	std::unique_lock<std::mutex> lock(_mutex);
+	size_t len;
+
+	if (_rxIdx==_rxLen) fill(lock,0);
+	len = _rxLen-_rxIdx;
+	if (len>maxLen) len = maxLen;
+	memcpy(buf,&_rxBuf[_rxIdx],len);
+	_rxIdx += len;
+	return len;
+}
+
+void CIVptyTransport::write(uint8_t ch) {
+	if (_fd<0) return;
+
+	while ((::write(_fd,&ch,1)<0) && (errno==EAGAIN)) {
+		struct pollfd pfd = {_fd, POLLOUT, 0};
+		poll(&pfd,1,10);
+	}
+
+	if (_echo) {														// one-wire bus -> own bytes are received as well
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_rxLen==(int)sizeof(_rxBuf)) {
+			if (_rxIdx==0) return;								// no room left -> the echo is lost
+			memmove(_rxBuf,&_rxBuf[_rxIdx],_rxLen-_rxIdx);
+			_rxLen -= _rxIdx; _rxIdx = 0;
+		}
+		_rxBuf[_rxLen++] = ch;
+	}
+}
+
+void CIVptyTransport::write(const uint8_t buf[], size_t len) {
+	size_t sent = 0;
+	ssize_t ret;
+
+	if (_fd<0) return;
+
+	while (sent<len) {
+		ret = ::write(_fd,&buf[sent],len-sent);
+		if (ret>0) sent += ret;
+		else if ((ret<0) && (errno==EAGAIN)) {
+			struct pollfd pfd = {_fd, POLLOUT, 0};
+			poll(&pfd,1,10);
+		}
+		else return;
+	}
+
+	if (_echo) {														// one-wire bus -> own bytes are received as well
+		std::lock_guard<std::mutex> lock(_mutex);
+		if ((_rxIdx>0) && (_rxLen+len>sizeof(_rxBuf))) {
+			memmove(_rxBuf,&_rxBuf[_rxIdx],_rxLen-_rxIdx);
+			_rxLen -= _rxIdx; _rxIdx = 0;
+		}
+		if (_rxLen+len>sizeof(_rxBuf)) len = sizeof(_rxBuf)-_rxLen;	// no room left -> the rest of the echo is lost
+		memcpy(&_rxBuf[_rxLen],buf,len);
+		_rxLen += len;
+	}
+}
+
+void CIVptyTransport::flushOutput() {
+	if (_fd>=0) tcdrain(_fd);
+}
+
+//::::::::: wait for received bytes and read them
+size_t CIVptyTransport::readWait(uint8_t buf[], size_t maxLen, unsigned long timeout) {
+	std::unique_lock<std::mutex> lock(_mutex);
+	size_t len = 0;
+
+	if (_rxIdx==_rxLen) fill(lock,timeout);
+	while ((len<maxLen) && (_rxIdx<_rxLen)) buf[len++] = _rxBuf[_rxIdx++];
+	return len;
+}
+
+//::::::::: read the bytes available into _rxBuf (waiting up to timeout [us] for the first one)
+bool CIVptyTransport::fill(std::unique_lock<std::mutex> &lock, unsigned long timeout) {
+	struct pollfd pfd = {_fd, POLLIN, 0};
+	ssize_t len;
+	int ready;
+
+	if (_fd<0) return false;
+	if (_rxIdx==_rxLen) {_rxIdx = 0; _rxLen = 0;}
+	if (_rxLen==(int)sizeof(_rxBuf)) return true;
+
+	if (timeout>0) lock.unlock();						// don't block the echo of write() while waiting
+	ready = poll(&pfd,1,(int)((timeout+999)/1000));
+	if (timeout>0) lock.lock();
+	if ((ready<=0) || (_rxLen==(int)sizeof(_rxBuf))) return false;
+	len = ::read(_fd,&_rxBuf[_rxLen],sizeof(_rxBuf)-_rxLen);
+	if (len<=0) return false;
+	_rxLen += len;
+	return true;
+}
+
+
+//------------------------------------------------------------------------
+// class CIVreplayTransport
+
+static uint64_t replayClock() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//ctor = constructor
+CIVreplayTransport::CIVreplayTransport() : _speed(1.0), _pending(false), _eof(true), _started(false),
+	_ts0(0), _t0(0), _replayed(0)
+{
+}
+
+//::::::::: open the capture
+bool CIVreplayTransport::open(const char path[], const double speed) {
+
+	_speed = speed;
+	_pending = false;
+	_started = false;
+	_replayed = 0;
+	_eof = !_reader.open(path);
+	return !_eof;
+
+}
+
+//::::::::: all frames replayed and read
+bool CIVreplayTransport::done() {
+	pump();
+	return _eof && (!_pending) && (CIVmemTransport::available()==0);
+}
+
+//::::::::: feed the frames which are due
+void CIVreplayTransport::pump() {
+
+	while (!_eof) {
+		if (!_pending) {
+			if (!_reader.next(_rec,_frame)) {_eof = true; return;}
+			if (_rec.evt!=CIV_trRX) continue;												// sent by the master at that time
+			_pending = true;
+			if (!_started) {_ts0 = _rec.ts; _t0 = replayClock(); _started = true;}	// timing relative to the 1st frame
+		}
+
+		if (_speed<=0) {																					// as fast as possible: keep the
+			if (CIVmemTransport::available()>=CIVrxChunkSize) return;	// receiver busy, but not flooded
+		}
+		else if (untilNext()>0) return;
+
+		feed(_frame,_rec.len);
+		_pending = false;
+		_replayed++;
+	}
+
+}
+
+//::::::::: [us] until the next frame is due
+unsigned long CIVreplayTransport::untilNext() {
+
+	double due, now;
+
+	if (!_pending || (_speed<=0)) return 0;
+	due = double(_rec.ts-_ts0)/_speed;
+	now = double(replayClock()-_t0);
+	return (due>now) ? (unsigned long)(due-now) : 0;
+
+}
+
+//::::::::: wait for received bytes (reader thread of CIVbus)
+size_t CIVreplayTransport::readWait(uint8_t buf[], size_t maxLen, unsigned long timeout) {
+
+	unsigned long wait;
+
+	pump();
+	wait = untilNext();																					// wake up in time for the next frame
+	if ((_pending) && (wait<timeout)) timeout = wait;
+	return CIVmemTransport::readWait(buf, maxLen, timeout);
+
+}
+
+#endif // useHost
+
+#endif // !ARDUINO
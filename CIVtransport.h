@@ -0,0 +1,299 @@
+/*
+	CIVtransport.h - Library for communication via ICOM's CI-V bus
+	Released into the public domain
+
+	Transports (i.e. the low level access to the CI-V bus) for the class template CIVbus.
+	The transport is a template parameter of CIVbus, so every byte-wise access is resolved at compile time
+	and inlined into the concrete backend - there is no runtime decision per byte.
+
+	Every transport provides:
+		static constexpr bool hasBT					true, if the transport can be switched to Bluetooth (setupp(true))
+		static constexpr bool hasReadBuf		true, if the transport can deliver all received bytes at once (readBuf)
+		void	begin(unsigned long baudrate)	initialisation of the interface (again: change of the baudrate)
+		void	beginBT(const char name[])		initialisation of the Bluetooth interface (if hasBT)
+		int		available()										no of bytes received
+		int		read()												read one received byte
+		void	write(uint8_t ch)							send one byte
+		void	write(buf,len)								send a complete frame with one call
+		void	flushOutput()									wait, until all bytes have been sent
+		void	attachRxRing(CIVrxRing &ring)	push the received bytes into ring in the background (if supported)
+		size_t readBuf(buf,maxLen)					read up to maxLen received bytes without waiting (if hasReadBuf)
+	host transports in addition:
+		size_t readWait(buf,maxLen,timeout)	wait up to timeout [us] for received bytes (reader thread of CIVbus)
+
+	This file will be included by CIVmaster.h automatically.
+*/
+#ifndef CIVtransport_h
+#define CIVtransport_h
+
+
+// defaults for the optional parts of a transport
+class CIVtransportBase {
+
+public:
+
+	static constexpr bool hasBT = false;
+	static constexpr bool hasReadBuf = false;
+
+	void		beginBT(const char name[])			{(void)name;}
+	size_t	readBuf(uint8_t buf[], size_t maxLen)	{(void)buf; (void)maxLen; return 0;}
+	void		attachRxRing(CIVrxRing &ring)		{(void)ring;}	// -> bytes have to be pushed by the application
+
+}; // end class CIVtransportBase
+
+
+//------------------------------------------------------------------------
+// Arduino boards
+
+#if defined(useSerial_1) || defined(useSerial_2)
+
+// HW serial interface (Serial1 on Mega2560, Serial2 on ESP32 by default)
+class CIVserialTransport : public CIVtransportBase {
+
+public:
+
+	CIVserialTransport(HardwareSerial &serial = CIV_SERIAL) : _serial(serial) {}
+
+	void		begin(unsigned long baudrate)		{_serial.begin(baudrate); _serial.setTimeout(UART_TIMEOUT);}
+	int			available()											{return _serial.available();}
+	int			read()													{return _serial.read();}
+	void		write(uint8_t ch)								{_serial.write(ch);}
+	void		write(const uint8_t buf[], size_t len)	{_serial.write(buf,len);}
+	void		flushOutput()										{_serial.flush();}
+
+#if defined(ESP32) && defined(ESP_ARDUINO_VERSION_MAJOR) && (ESP_ARDUINO_VERSION_MAJOR>=2)
+	void		attachRxRing(CIVrxRing &ring)		{
+		CIVrxRing *pRing = &ring; HardwareSerial *pSerial = &_serial;
+		_serial.onReceive([pRing,pSerial]() {while (pSerial->available()>0) pRing->push(pSerial->read());});
+	}
+#endif
+
+	HardwareSerial &serial()								{return _serial;}
+
+private:
+
+	HardwareSerial	&_serial;
+
+}; // end class CIVserialTransport
+
+#endif
+
+#ifdef useAltSoftSerial
+
+// SW emulation of a serial interface (Arduino Pins 8 and 9 on Uno, Nano, Pro, Pro Mini)
+class CIValtSoftTransport : public CIVtransportBase {
+
+public:
+
+	void		begin(unsigned long baudrate)		{_serial.begin(baudrate); _serial.setTimeout(UART_TIMEOUT);}
+	int			available()											{return _serial.available();}
+	int			read()													{return _serial.read();}
+	void		write(uint8_t ch)								{_serial.write(ch);}
+	void		write(const uint8_t buf[], size_t len)	{_serial.write(buf,len);}
+	void		flushOutput()										{_serial.flushOutput();}
+
+private:
+
+	AltSoftSerial		_serial;
+
+}; // end class CIValtSoftTransport
+
+#endif
+
+#ifdef useBluetooth
+
+// Bluetooth (classic) of the ESP32, e.g. for the IC705
+class CIVbtTransport : public CIVtransportBase {
+
+public:
+
+	static constexpr bool hasBT = true;
+
+	void		begin(unsigned long baudrate)		{(void)baudrate; _bt.begin(BT_NAME);}
+	void		beginBT(const char name[])			{_bt.begin(name);}
+	int			available()											{return _bt.available();}
+	int			read()													{return _bt.read();}
+	void		write(uint8_t ch)								{_bt.write(ch);}
+	void		write(const uint8_t buf[], size_t len)	{_bt.write(buf,len);}	// one BT packet instead of one per byte
+	void		flushOutput()										{_bt.flush();}
+
+#if defined(ESP_ARDUINO_VERSION_MAJOR) && (ESP_ARDUINO_VERSION_MAJOR>=2)
+	void		attachRxRing(CIVrxRing &ring)		{
+		CIVrxRing *pRing = &ring;
+		_bt.onData([pRing](const uint8_t *buf, size_t len) {pRing->push(buf,len);});
+	}
+#endif
+
+	BluetoothSerial &serial()								{return _bt;}
+
+private:
+
+	BluetoothSerial	_bt;
+
+}; // end class CIVbtTransport
+
+// ESP32: Serial2 or Bluetooth, selected by setupp at runtime (opt-in: "CIVbus<CIVesp32Transport> civ;",
+// the default CIV is CIVbus<CIVserialTransport>, see CIVmaster.h).
+// Note: this costs one indirect call per byte; if the interface is fixed, CIVbus<CIVserialTransport>
+// or CIVbus<CIVbtTransport> should be used instead.
+class CIVesp32Transport : public CIVtransportBase {
+
+public:
+
+	CIVesp32Transport(HardwareSerial &serial = CIV_SERIAL) : _serial(serial), _stream(&serial) {}
+
+	static constexpr bool hasBT = true;
+
+	void		begin(unsigned long baudrate)		{_serial.begin(baudrate); _BT = false; _stream = &_serial.serial();}
+	void		beginBT(const char name[])			{_bt.beginBT(name); _BT = true; _stream = &_bt.serial();}
+	int			available()											{return _stream->available();}
+	int			read()													{return _stream->read();}
+	void		write(uint8_t ch)								{_stream->write(ch);}
+	void		write(const uint8_t buf[], size_t len)	{_stream->write(buf,len);}
+	void		flushOutput()										{_stream->flush();}
+
+	void		attachRxRing(CIVrxRing &ring)		{
+		if (_BT)	_bt.attachRxRing(ring);
+		else			_serial.attachRxRing(ring);
+	}
+
+private:
+
+	CIVserialTransport	_serial;
+	CIVbtTransport			_bt;
+	Stream							*_stream;
+	bool								_BT = false;
+
+}; // end class CIVesp32Transport
+
+#endif
+
+
+//------------------------------------------------------------------------
+// Linux host
+
+#ifdef useHost
+
+// in-memory loopback: byte-feeding stand-in of the serial interface.
+// The host program feeds the bytes "received from the bus" via feed() and reads back the bytes
+// "sent to the bus" via fetch(). Like on the one-wire CI-V bus, the sent bytes are received again (echo).
+class CIVmemTransport : public CIVtransportBase {
+
+public:
+
+	CIVmemTransport();
+
+	static constexpr bool hasReadBuf = true;
+
+	void		begin(unsigned long baudrate)		{(void)baudrate;}
+	int			available();
+	int			read();
+	size_t	readBuf(uint8_t buf[], size_t maxLen);
+	void		write(uint8_t ch);
+	void		write(const uint8_t buf[], size_t len);
+	void		flushOutput()										{}
+	size_t	readWait(uint8_t buf[], size_t maxLen, unsigned long timeout);
+
+	// access from the host program ("other side of the bus")
+	void		feed(const uint8_t buf[], size_t len);		// bytes received from the bus
+	size_t	fetch(uint8_t buf[], size_t maxLen);			// bytes sent to the bus
+	void		setEcho(bool echo);												// one-wire bus: sent bytes are received again (default)
+
+private:
+
+	std::mutex							_mutex;
+	std::condition_variable	_rxEvent;
+	std::deque<uint8_t>			_rx;
+	std::deque<uint8_t>			_tx;
+	bool										_echo;
+
+}; // end class CIVmemTransport
+
+
+// POSIX tty (e.g. /dev/ttyUSB0 of an USB CI-V interface) or pseudo terminal (pty).
+// A pty is created by openPty(); the name of its other side (slave) can be handed over to another
+// program (or to a second CIVbus<CIVptyTransport> via open()).
+class CIVptyTransport : public CIVtransportBase {
+
+public:
+
+	CIVptyTransport();
+	~CIVptyTransport();
+
+	bool		open(const char path[]);					// open an existing tty/pty
+	bool		openPty();												// create a new pty and use its master side
+	const char *slaveName();									// name of the other side of the pty
+	void		close();
+
+	static constexpr bool hasReadBuf = true;
+
+	void		begin(unsigned long baudrate);		// sets the baudrate, if it's a tty
+	int			available();
+	int			read();
+	size_t	readBuf(uint8_t buf[], size_t maxLen);
+	void		write(uint8_t ch);
+	void		write(const uint8_t buf[], size_t len);
+	void		flushOutput();
+	size_t	readWait(uint8_t buf[], size_t maxLen, unsigned long timeout);
+
+	void		setEcho(bool echo)							{_echo = echo;}	// tty/pty doesn't echo -> emulate the one-wire bus
+
+private:
+
+	bool		fill(std::unique_lock<std::mutex> &lock, unsigned long timeout);	// read the bytes available into _rxBuf
+
+	std::mutex	_mutex;									// _rxBuf is shared by the reader thread and the echo of write()
+	int			_fd;
+	bool		_echo;
+	char		_slaveName[64];
+
+	uint8_t	_rxBuf[CIV_BUFFERSIZE];
+	int			_rxIdx;
+	int			_rxLen;
+
+}; // end class CIVptyTransport
+
+
+// replay of a capture (CIVcapture.h): the frames received at that time are fed in again as if they came
+// from the bus, the frames sent at that time are skipped (the own commands are echoed as by CIVmemTransport).
+// speed: 1.0 original timing, 2.0 twice as fast ..., 0: as fast as possible (independent of the time).
+// The order of the bytes is always the same, i.e. parser and ICradio tests are reproducible.
+class CIVreplayTransport : public CIVmemTransport {
+
+public:
+
+	CIVreplayTransport();
+
+	bool		open(const char path[], const double speed = 1.0);
+	void		setSpeed(const double speed)		{_speed = speed;}
+	CIVcaptureReader &reader()							{return _reader;}	// e.g. seek/setAddrFilter before the replay
+	bool		done();														// all frames replayed and read
+	uint32_t	replayed()											{return _replayed;}	// no of frames fed in so far
+
+	int			available()											{pump(); return CIVmemTransport::available();}
+	int			read()													{pump(); return CIVmemTransport::read();}
+	size_t	readBuf(uint8_t buf[], size_t maxLen)	{pump(); return CIVmemTransport::readBuf(buf,maxLen);}
+	size_t	readWait(uint8_t buf[], size_t maxLen, unsigned long timeout);
+
+private:
+
+	void		pump();														// feed the frames which are due
+	unsigned long	untilNext();										// [us] until the next frame is due
+
+	CIVcaptureReader	_reader;
+	double					_speed;
+	bool						_pending;									// _rec/_frame: next frame to be fed
+	bool						_eof;
+	bool						_started;
+	CIVcapRec_t			_rec;
+	uint8_t					_frame[256];
+	uint64_t				_ts0;											// time of the first frame in the capture
+	uint64_t				_t0;											// start of the replay (steady clock) [us]
+	uint32_t				_replayed;
+
+}; // end class CIVreplayTransport
+
+#endif
+
+
+#endif
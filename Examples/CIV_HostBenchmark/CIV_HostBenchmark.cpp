@@ -0,0 +1,322 @@
+/*
+CIVmasterlib CIV_HostBenchmark - throughput of the hot paths on a Linux host
+
+This is not a sketch - it runs on the host (no Arduino core, "useHost" in CIVmaster.h) and
+measures against the in-memory transport (CIVmemTransport):
+	- the BCD codec (CIVbcd)
+	- the bulk ingest of CIVframer (collect(buf,len) compared with collect(inByte)), in MB/s as well
+	- the receive path: readMsgRaw, readMsg with several registered devices, readMsgRef
+	  (bytes in CIVmemTransport -> CIVframer -> decodeMsg -> mailboxes)
+	- the send path: framing and writing of writeMsg (CIV_wFast, no echo)
+	- the dispatch of ICradio::getNewMsg
+
+build and run (in this directory):
+	g++ -std=c++11 -O2 -I../.. ../../[A-Z]*.cpp CIV_HostBenchmark.cpp -o CIV_HostBenchmark -lpthread
+	./CIV_HostBenchmark								(table)
+	./CIV_HostBenchmark --json > result.json		(machine-readable, e.g. to compare releases)
+
+*/
+
+/* includes -----------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+#include "CIVcmds.h"
+#include "CIVmaster.h"
+#include "ICradio.h"
+
+// Global compile switches ===================================================================================
+
+#define VERSION_STRING "CIVmasterLib CIV_HostBenchmark V0_3 26/10/17"
+
+constexpr unsigned long NO_OF_LOOPS	= 10000000;		// BCD conversions per test
+constexpr unsigned long NO_OF_FRAMES	= 1000000;		// frames per test
+constexpr unsigned long NO_OF_BYTES		= 64000000;		// bytes per test of the framer
+constexpr uint8_t MAX_RESULTS					= 16;
+
+//-------------------------------------------------------------------------------
+// create the civ object
+CIV     civ;
+
+volatile uint64_t sink;													// prevents the optimisation of the results
+
+//-------------------------------------------------------------------------------
+// measurement
+
+typedef std::chrono::steady_clock benchClock;
+
+typedef struct {
+	const char			*name;
+	unsigned long		count;
+	double					secs;
+	unsigned long		bytes;										// bytes processed (0: not a throughput test)
+} benchResult_t;
+
+benchResult_t results[MAX_RESULTS];
+uint8_t				noOfResults = 0;
+
+void recordResult(const char name[], unsigned long count, benchClock::time_point ts_start,
+									unsigned long bytes = 0) {
+	double secs = std::chrono::duration<double>(benchClock::now()-ts_start).count();
+
+	if (noOfResults<MAX_RESULTS) results[noOfResults++] = {name, count, secs, bytes};
+}
+
+void printTable() {
+	for (uint8_t idx=0; idx<noOfResults; idx++) {
+		const benchResult_t &res = results[idx];
+		printf("%-36s %10lu in %7.3f s -> %8.2f M/s  %7.2f ns each",
+			res.name, res.count, res.secs, res.count/res.secs/1e6, res.secs*1e9/res.count);
+		if (res.bytes>0) printf("  %8.1f MB/s", res.bytes/res.secs/1e6);
+		printf("\n");
+	}
+}
+
+void printJSON() {
+	printf("{\n  \"version\": \"%s\",\n  \"results\": [\n", VERSION_STRING);
+	for (uint8_t idx=0; idx<noOfResults; idx++) {
+		const benchResult_t &res = results[idx];
+		printf("    {\"name\": \"%s\", \"count\": %lu, \"seconds\": %.6f, \"per_second\": %.0f, \"ns_each\": %.2f",
+			res.name, res.count, res.secs, res.count/res.secs, res.secs*1e9/res.count);
+		if (res.bytes>0) printf(", \"bytes\": %lu, \"mb_per_second\": %.1f", res.bytes, res.bytes/res.secs/1e6);
+		printf("}%s\n", (idx+1<noOfResults) ? "," : "");
+	}
+	printf("  ]\n}\n");
+}
+
+//-------------------------------------------------------------------------------
+// batch of noOfFrames frequency broadcasts of the devices addr[0..noOfAddr-1] (one after the other)
+constexpr uint8_t FRAMES_PER_BATCH = 16;							// < CIVresultBufSize
+constexpr uint8_t FRAME_LENGTH = 11;
+
+void buildBatch(uint8_t batch[], const uint8_t addr[], const uint8_t noOfAddr,
+								const uint8_t noOfFrames = FRAMES_PER_BATCH) {
+	uint8_t frame[FRAME_LENGTH] = {0xFE,0xFE,0xE0,0x00,CIV_C_F_SEND[1],0x00,0x50,0x34,0x07,0x00,0xFD};
+
+	for (uint8_t idx=0; idx<noOfFrames; idx++) {
+		frame[3] = addr[idx%noOfAddr];
+		frame[5] = CIVbcd::toBcd(idx);
+		memcpy(&batch[idx*FRAME_LENGTH],frame,FRAME_LENGTH);
+	}
+}
+
+//-------------------------------------------------------------------------------
+// reference: decoding nibble by nibble (as in earlier versions of decodeMsg)
+unsigned long decodeNibbles(const uint8_t bcd[], uint8_t len) {
+	unsigned long value = 0, mul = 1;
+
+	for (uint8_t idx=0; idx<len; idx++) {
+		value += (bcd[idx] & 0x0f) * mul; mul *= 10;
+		value += (bcd[idx] >> 4) * mul; mul *= 10;
+	}
+	return value;
+}
+
+//-------------------------------------------------------------------------------
+void benchBCD() {
+	uint8_t freq5[5] = {0x00,0x50,0x34,0x07,0x00};				// 7.345 MHz
+	uint8_t freq6[6] = {0x00,0x00,0x00,0x50,0x04,0x01};		// 10.450 GHz
+	uint64_t sum = 0;
+	benchClock::time_point ts_start;
+
+	ts_start = benchClock::now();
+	for (unsigned long i=0; i<NO_OF_LOOPS; i++) {freq5[0] = uint8_t(i&0x77); sum += decodeNibbles(freq5,5);}
+	recordResult("decode 5 bytes, nibble by nibble",NO_OF_LOOPS,ts_start);
+
+	ts_start = benchClock::now();
+	for (unsigned long i=0; i<NO_OF_LOOPS; i++) {
+		freq5[0] = uint8_t(i&0x77); sum += CIVbcd::decode<unsigned long>(freq5,5,CIV_bcdLittleEndian);
+	}
+	recordResult("decode 5 bytes, CIVbcd (32 bit)",NO_OF_LOOPS,ts_start);
+
+	ts_start = benchClock::now();
+	for (unsigned long i=0; i<NO_OF_LOOPS; i++) {
+		freq6[0] = uint8_t(i&0x77); sum += CIVbcd::decode(freq6,6,CIV_bcdLittleEndian);
+	}
+	recordResult("decode 6 bytes, CIVbcd (64 bit)",NO_OF_LOOPS,ts_start);
+
+	ts_start = benchClock::now();
+	for (unsigned long i=0; i<NO_OF_LOOPS; i++) {
+		CIVbcd::encode(uint64_t(10450000000ULL+i),freq6,6,CIV_bcdLittleEndian); sum += freq6[0];
+	}
+	recordResult("encode 6 bytes, CIVbcd (64 bit)",NO_OF_LOOPS,ts_start);
+
+	sink = sum;
+}
+
+//-------------------------------------------------------------------------------
+// CIVframer alone: a large buffer of frames (mixed lengths, some noise in between)
+void benchFramer() {
+	constexpr size_t BUF_LENGTH = 65536;
+	static uint8_t buf[BUF_LENGTH];
+	const uint8_t addr[4] = {CIV_ADDR_705, CIV_ADDR_7300, CIV_ADDR_9700, CIV_ADDR_7100};
+	uint8_t batch[FRAMES_PER_BATCH*FRAME_LENGTH];
+	const uint8_t ack[6] = {0xFE,0xFE,0xE0,CIV_ADDR_705,C_OK,0xFD};
+	const uint8_t noise[3] = {0x12,0x00,0x34};
+	CIVframer framer;
+	size_t len = 0, idx;
+	unsigned long count, bytes;
+	benchClock::time_point ts_start;
+
+	buildBatch(batch,addr,4);
+	while (len+sizeof(batch)+sizeof(ack)+sizeof(noise)<=BUF_LENGTH) {
+		memcpy(&buf[len],batch,sizeof(batch));		len += sizeof(batch);
+		memcpy(&buf[len],ack,sizeof(ack));				len += sizeof(ack);
+		memcpy(&buf[len],noise,sizeof(noise));		len += sizeof(noise);
+	}
+
+	//............. byte by byte (state machine for every byte)
+	count = 0; bytes = 0;
+	ts_start = benchClock::now();
+	while (bytes<NO_OF_BYTES) {
+		for (idx=0; idx<len; idx++) if (framer.collect(buf[idx])) count++;
+		bytes += len;
+	}
+	recordResult("CIVframer::collect(inByte)",count,ts_start,bytes);
+
+	//............. bulk ingest (memchr + copy of the frame body)
+	count = 0; bytes = 0;
+	framer.reset();
+	ts_start = benchClock::now();
+	while (bytes<NO_OF_BYTES) {
+		for (idx=0; idx<len; ) {
+			idx += framer.collect(&buf[idx], len-idx);
+			if (framer.state==CIV_stop) count++;
+		}
+		bytes += len;
+	}
+	recordResult("CIVframer::collect(buf,len)",count,ts_start,bytes);
+}
+
+//-------------------------------------------------------------------------------
+void benchReceive() {
+	const uint8_t addr[4] = {CIV_ADDR_705, CIV_ADDR_7300, CIV_ADDR_9700, CIV_ADDR_7100};
+	uint8_t batch[FRAMES_PER_BATCH*FRAME_LENGTH];
+	uint64_t sum = 0;
+	unsigned long count;
+	benchClock::time_point ts_start;
+	CIVresult_t res;
+
+	civ.setupp();
+	civ.registerAddr(CIV_ADDR_705);
+
+	//............. readMsgRaw: one device, no mailboxes
+	buildBatch(batch,addr,1);
+	count = 0;
+	ts_start = benchClock::now();
+	while (count<NO_OF_FRAMES) {
+		civ.transport().feed(batch,sizeof(batch));
+		while ((res = civ.readMsgRaw()).retVal==CIV_OK_DAV) {sum += res.value; count++;}
+	}
+	recordResult("readMsgRaw",count,ts_start);
+
+	//............. readMsgRef: one device
+	count = 0;
+	ts_start = benchClock::now();
+	while (count<NO_OF_FRAMES) {
+		civ.transport().feed(batch,sizeof(batch));
+		for (CIVmsgRef msg = civ.readMsgRef(CIV_ADDR_705); msg; msg = civ.readMsgRef(CIV_ADDR_705)) {
+			sum += msg->value; count++;
+		}
+	}
+	recordResult("readMsgRef, 1 device",count,ts_start);
+
+	//............. readMsg: 4 devices interleaved, every device fetches its own messages
+	for (uint8_t idx=1; idx<4; idx++) civ.registerAddr(addr[idx]);
+	buildBatch(batch,addr,4);
+	count = 0;
+	ts_start = benchClock::now();
+	while (count<NO_OF_FRAMES) {
+		civ.transport().feed(batch,sizeof(batch));
+		for (uint8_t idx=0; idx<FRAMES_PER_BATCH; idx++) {
+			res = civ.readMsg(addr[idx&3]);
+			if (res.retVal==CIV_OK_DAV) {sum += res.value; count++;}
+		}
+	}
+	recordResult("readMsg, 4 devices",count,ts_start);
+
+	for (uint8_t idx=0; idx<4; idx++) civ.unregisterAddr(addr[idx]);
+	sink = sum;
+}
+
+//-------------------------------------------------------------------------------
+void benchSend() {
+	uint8_t out[1024];
+	uint8_t freq[6] = {5,0x00,0x50,0x34,0x07,0x00};
+	unsigned long count;
+	uint64_t sum = 0;
+	benchClock::time_point ts_start;
+
+	civ.transport().setEcho(false);										// the framing only, no echo check
+
+	ts_start = benchClock::now();
+	for (count=0; count<NO_OF_FRAMES; count++) {
+		sum += civ.writeMsg(CIV_ADDR_705,CIV_C_F_READ,CIV_D_NIX,CIV_wFast).retVal;
+		if ((count&63)==0) civ.transport().fetch(out,sizeof(out));
+	}
+	recordResult("writeMsg query (cached frame)",count,ts_start);
+
+	ts_start = benchClock::now();
+	for (count=0; count<NO_OF_FRAMES; count++) {
+		freq[1] = uint8_t(count);
+		sum += civ.writeMsg(CIV_ADDR_705,CIV_C_F_SEND,freq,CIV_wFast).retVal;
+		if ((count&63)==0) civ.transport().fetch(out,sizeof(out));
+	}
+	recordResult("writeMsg with data (built)",count,ts_start);
+
+	civ.transport().fetch(out,sizeof(out));
+	civ.transport().setEcho(true);
+	sink = sum;
+}
+
+//-------------------------------------------------------------------------------
+void benchICradio() {
+	const uint8_t addr[1] = {CIV_ADDR_7300};
+	uint8_t batch[FRAMES_PER_BATCH*FRAME_LENGTH];
+	uint8_t modFrame[8] = {0xFE,0xFE,0xE0,CIV_ADDR_7300,CIV_C_MOD_SEND[1],0x01,0x01,0xFD};
+	ICradio IC7300(TypeIC7300,CIV_ADDR_7300,civ);
+	unsigned long count = 0;
+	uint64_t sum = 0;
+	size_t len;
+	benchClock::time_point ts_start;
+
+	IC7300.setupp(0);
+	buildBatch(batch,addr,1,FRAMES_PER_BATCH/2);						// frequencies, then ModModes
+	len = FRAMES_PER_BATCH/2*FRAME_LENGTH;
+	for (uint8_t idx=0; idx<FRAMES_PER_BATCH/2; idx++) {
+		memcpy(&batch[len],modFrame,sizeof(modFrame));
+		len += sizeof(modFrame);
+	}
+
+	ts_start = benchClock::now();
+	while (count<NO_OF_FRAMES) {
+		civ.transport().feed(batch,len);
+		while (IC7300.getNewMsg().retVal==CIV_OK_DAV) count++;
+		sum += IC7300.getFrequency() + IC7300.getModMode();
+	}
+	recordResult("ICradio::getNewMsg",count,ts_start);
+
+	civ.unregisterAddr(CIV_ADDR_7300);
+	sink = sum;
+}
+
+//============================================================================================
+int main(int argc, char *argv[]) {
+
+	bool json = (argc>1) && (strcmp(argv[1],"--json")==0);
+
+	if (!json) printf("%s\n\n",VERSION_STRING);
+
+	benchBCD();
+	benchFramer();
+	benchReceive();
+	benchSend();
+	benchICradio();
+
+	if (json)	printJSON();
+	else			printTable();
+
+	return 0;
+}
@@ -0,0 +1,116 @@
+/*
+CIVmasterlib CIV_HostIoTest - the bus served by the I/O task (CIVio), commands from many threads
+
+This is not a sketch - it runs on the host (no Arduino core, "useHost" in CIVmaster.h).
+N radios are emulated by CIVemulator (addresses 0x80, 0x81 ...), the bus is served by the I/O task.
+P producer threads submit frequency queries to the radios in turn (tagged, i.e. the result of
+writeMsg is reported), the main thread takes everything out of the receive queue.
+After the runtime, the throughput, the latencies of the answers and the counters of the I/O task
+are printed, e.g. to see how the bounded queues behave with many producers.
+
+build and run (in this directory):
+	g++ -std=c++11 -O2 -I../.. ../../[A-Z]*.cpp CIV_HostIoTest.cpp -o CIV_HostIoTest -lpthread
+	./CIV_HostIoTest [producers [radios [seconds [latency us]]]]
+	e.g. ./CIV_HostIoTest 16 4 10 500		(16 threads, 4 radios, 10s, 0.5ms response time)
+
+*/
+
+/* includes -----------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+
+#include "CIVcmds.h"
+#include "CIVmaster.h"
+#include "ICradio.h"
+#include "CIVemulator.h"
+
+// Global compile switches ===================================================================================
+
+#define VERSION_STRING "CIVmasterLib CIV_HostIoTest V0_1 26/10/17"
+
+constexpr uint8_t	FIRST_ADDR = 0x80;
+
+//-------------------------------------------------------------------------------
+// create the civ object
+CIV     civ;
+
+CIVemulator emu(civ.transport());
+CIVio       io(civ);
+
+std::atomic<bool>	run {true};
+std::atomic<unsigned long> ts_submit[65536];		// time of the submission per tag [us]
+
+//-------------------------------------------------------------------------------
+void producer(const uint8_t idx, const uint8_t noOfRadios) {
+	uint16_t	tag = idx<<10;
+
+	while (run) {
+		tag = (idx<<10) | ((tag+1) & 0x3FF);
+		if (tag==0) continue;
+		ts_submit[tag] = micros();
+		if (!io.submit(FIRST_ADDR + tag%noOfRadios, CIV_C_F_READ, CIV_D_NIX, CIV_wChk, tag, 10)) ts_submit[tag] = 0;
+	}
+}
+
+//============================================================================================
+int main(int argc, char *argv[]) {
+
+	uint8_t noOfProducers				= (argc>1) ? atoi(argv[1]) : 8;
+	uint8_t noOfRadios					= (argc>2) ? atoi(argv[2]) : 4;
+	unsigned long t_msRun				= (argc>3) ? 1000UL*atol(argv[3]) : 10000;
+	CIVemuConfig_t config				= CIVemuDefault;
+	std::vector<std::thread> producers;
+	CIVhist_t latency = {{0},0};
+	unsigned long frames = 0, results = 0, failed = 0, ts_start;
+	CIVioMsg_t msg;
+
+	config.t_usLatency		= (argc>4) ? atol(argv[4]) : 1000;
+	if (noOfProducers>63) noOfProducers = 63;
+	if (noOfRadios>CIVmailboxCount) noOfRadios = CIVmailboxCount;
+
+	printf("%s\n\n%u producers, %u radios, %lu s, response time %lu us\n\n",VERSION_STRING,
+		noOfProducers, noOfRadios, t_msRun/1000, config.t_usLatency);
+
+	civ.setupp();
+	for (uint8_t idx=0; idx<noOfRadios; idx++) {
+		emu.addRadio(TypeIC7300, FIRST_ADDR+idx, config).setFrequency(14000000+1000*idx);
+		civ.registerAddr(FIRST_ADDR+idx);
+	}
+	emu.start();
+	io.start();
+	for (uint8_t idx=0; idx<noOfProducers; idx++) producers.emplace_back(producer, idx+1, noOfRadios);
+
+	ts_start = millis();
+	while ((millis()-ts_start)<t_msRun) {
+		if (!io.receive(msg, 10)) continue;
+		if (msg.tag==0) {frames++; continue;}
+		results++;
+		if (msg.result.retVal!=CIV_OK) failed++;
+		if (ts_submit[msg.tag]!=0) {												// submit -> written on the bus
+			unsigned long t_us = micros()-ts_submit[msg.tag];
+			uint8_t bucket = 0;
+			while ((bucket<CIVhistBuckets-1) && ((t_us>>(bucket*CIVhistShift))!=0)) bucket++;
+			latency.bucket[bucket]++;
+			if (t_us>latency.max) latency.max = t_us;
+		}
+	}
+
+	run = false;
+	for (std::thread &thread : producers) thread.join();
+	io.stop();
+	emu.stop();
+
+	CIVioCounters_t cnt = io.counters();
+	printf("%lu commands written (%lu failed), %.0f per s; %lu frames received\n", results, failed,
+		1000.0*results/t_msRun, frames);
+	printf("submit -> written: p50 %lu us   p99 %lu us   max %lu us\n",
+		CIV::statsPercentile(latency,50), CIV::statsPercentile(latency,99), latency.max);
+	printf("io: written %u, rejected %u (queue full), received %u, dropped %u, loops %u\n",
+		cnt.cmdsWritten, cnt.cmdsRejected, cnt.msgsReceived, cnt.msgsDropped, cnt.loops);
+
+	return 0;
+}
@@ -0,0 +1,100 @@
+/*
+CIVmasterlib CIV_HostLoadTest - several emulated radios on one virtual bus
+
+This is not a sketch - it runs on the host (no Arduino core, "useHost" in CIVmaster.h).
+N radios are emulated by CIVemulator (IC7300, IC705, IC9700, IC7100 in turn, addresses 0x80, 0x81 ...),
+each of them is controlled by an instance of ICradio, as a sketch would do it with real radios.
+After the runtime, the state of the radios, the counters of the emulator and the statistics of civ
+(statsSnapshot) are printed, e.g. to see how readMsg and ICradio::loopp scale with the number of radios
+and the load on the bus.
+
+build and run (in this directory):
+	g++ -std=c++11 -O2 -I../.. ../../[A-Z]*.cpp CIV_HostLoadTest.cpp -o CIV_HostLoadTest -lpthread
+	./CIV_HostLoadTest [radios [seconds [broadcast ms [latency us [NOK %]]]]]
+	e.g. ./CIV_HostLoadTest 8 10 20 2000 5		(8 radios, 10s, broadcast every 20ms, 2ms response time, 5% NOK)
+
+*/
+
+/* includes -----------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "CIVcmds.h"
+#include "CIVmaster.h"
+#include "ICradio.h"
+#include "CIVemulator.h"
+
+// Global compile switches ===================================================================================
+
+#define VERSION_STRING "CIVmasterLib CIV_HostLoadTest V0_1 26/10/17"
+
+constexpr uint8_t	FIRST_ADDR = 0x80;
+
+//-------------------------------------------------------------------------------
+// create the civ object
+CIV     civ;
+
+CIVemulator emu(civ.transport());
+
+//-------------------------------------------------------------------------------
+void printHist(const char name[], const CIVhist_t &hist) {
+	printf("  %-12s p50 %8lu us   p99 %8lu us   max %8lu us\n", name,
+		CIV::statsPercentile(hist,50), CIV::statsPercentile(hist,99), hist.max);
+}
+
+//============================================================================================
+int main(int argc, char *argv[]) {
+
+	constexpr radioType_t types[] = {TypeIC7300, TypeIC705, TypeIC9700, TypeIC7100};
+	uint8_t noOfRadios					= (argc>1) ? atoi(argv[1]) : 4;
+	unsigned long t_msRun				= (argc>2) ? 1000UL*atol(argv[2]) : 10000;
+	CIVemuConfig_t config				= CIVemuDefault;
+	std::vector<ICradio> radios;
+	unsigned long loops = 0, ts_start;
+	CIVstats_t stats;
+
+	config.t_msBroadcast	= (argc>3) ? atol(argv[3]) : 50;
+	config.t_usLatency		= (argc>4) ? atol(argv[4]) : 1000;
+	config.t_usJitter			= config.t_usLatency/2;
+	config.nokPercent			= (argc>5) ? atoi(argv[5]) : 0;
+	if (noOfRadios>CIVmailboxCount) noOfRadios = CIVmailboxCount;
+
+	printf("%s\n\n%u radios, %lu s, broadcast every %lu ms, response time %lu us, %u%% NOK\n\n",VERSION_STRING,
+		noOfRadios, t_msRun/1000, config.t_msBroadcast, config.t_usLatency, config.nokPercent);
+
+	civ.setupp();
+	radios.reserve(noOfRadios);
+	for (uint8_t idx=0; idx<noOfRadios; idx++) {
+		emu.addRadio(types[idx%4], FIRST_ADDR+idx, config);
+		radios.emplace_back(types[idx%4], FIRST_ADDR+idx, civ);
+		radios.back().setupp(millis());
+		radios.back().setPushMode(config.t_msBroadcast>0);
+	}
+
+	ts_start = millis();
+	while ((millis()-ts_start)<t_msRun) {
+		emu.service();
+		for (ICradio &radio : radios) radio.loopp(millis());
+		loops++;
+	}
+
+	printf("%lu loops, %.2f us per loop\n\n", loops, 1000.0*t_msRun/loops);
+	for (ICradio &radio : radios) {
+		CIVemuRadio *emuRadio = emu.radio(radio.getCIVaddr());
+		const CIVemuCounters_t &cnt = emuRadio->counters();
+		printf("radio %02X: state %u f %10lu (emulated %10lu)  commands %6u broadcasts %6u NOKs %4u  dropped %u polls saved %u\n",
+			radio.getCIVaddr(), radio.getAvailability(), radio.getFrequency(), emuRadio->frequency(),
+			cnt.commands, cnt.broadcasts, cnt.noksInjected, civ.droppedMsgs(radio.getCIVaddr()), radio.getPollsSaved());
+	}
+
+	civ.statsSnapshot(stats);
+	printf("\ncivstats: received OK %u, data %u, NOK %u, incomplete %u; written OK %u, conflict %u\n",
+		(unsigned)stats.rxRetVal[CIV_OK], (unsigned)stats.rxRetVal[CIV_OK_DAV], (unsigned)stats.rxRetVal[CIV_NOK],
+		(unsigned)stats.rxRetVal[CIV_NO_MSG], (unsigned)stats.txRetVal[CIV_OK], (unsigned)stats.txRetVal[CIV_BUS_CONFLICT]);
+	printHist("readMsg", stats.rxTime);
+	printHist("request", stats.reqLatency);
+
+	return 0;
+}
@@ -0,0 +1,209 @@
+/*
+CIVmasterlib CIV_HostMemTest - receive path fed byte by byte via the in-memory transport
+
+This is not a sketch - it runs on the host (no Arduino core, "useHost" in CIVmaster.h).
+The frames "of the radios" are fed into CIVmemTransport byte by byte, split into several pieces,
+incomplete or mixed with the echo of the own commands; the results of readMsgRaw, readMsg and
+writeMsg (retVal, address, command, value) are compared with the expected ones.
+The exit code is the number of failed checks (0: everything OK).
+
+build and run (in this directory):
+	g++ -std=c++11 -O2 -I../.. ../../[A-Z]*.cpp CIV_HostMemTest.cpp -o CIV_HostMemTest -lpthread
+	./CIV_HostMemTest
+
+*/
+
+/* includes -----------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "CIVcmds.h"
+#include "CIVmaster.h"
+
+// Global compile switches ===================================================================================
+
+#define VERSION_STRING "CIVmasterLib CIV_HostMemTest V0_1 26/10/17"
+
+//-------------------------------------------------------------------------------
+// create the civ object
+CIV     civ;
+
+uint16_t failed = 0;
+
+// frames of the radios
+const uint8_t freq7300[] = {0xFE,0xFE,0xE0,CIV_ADDR_7300,0x03,0x00,0x50,0x34,0x07,0x00,0xFD};	// 7.345 MHz
+const uint8_t freq705[]  = {0xFE,0xFE,0xE0,CIV_ADDR_705, 0x03,0x00,0x00,0x80,0x44,0x01,0xFD};	// 144.8 MHz
+const uint8_t ok7300[]   = {0xFE,0xFE,0xE0,CIV_ADDR_7300,C_OK,0xFD};
+const uint8_t nok7300[]  = {0xFE,0xFE,0xE0,CIV_ADDR_7300,C_NOK,0xFD};
+const uint8_t freq9700[] = {0xFE,0xFE,0xE0,CIV_ADDR_9700,0x03,0x00,0x00,0x00,0x32,0x04,0xFD};	// not registered
+
+//-------------------------------------------------------------------------------
+void check(const bool ok, const char name[]) {
+	printf("%-60s %s\n", name, ok ? "OK" : "FAILED");
+	if (!ok) failed++;
+}
+
+void feed(const uint8_t buf[], const size_t len) {
+	civ.transport().feed(buf,len);
+}
+
+// feed the frame byte by byte, readMsgRaw after every byte; returns the result after the last byte
+CIVresult_t feedBytewise(const uint8_t frame[], const size_t len, bool &pendingSeen) {
+	CIVresult_t res;
+
+	pendingSeen = true;
+	for (size_t idx=0; idx<len; idx++) {
+		feed(&frame[idx],1);
+		res = civ.readMsgRaw();
+		if ((idx+1<len) && (res.retVal!=CIV_MSG_PENDING)) pendingSeen = false;
+	}
+	return res;
+}
+
+//-------------------------------------------------------------------------------
+void testBytewise() {
+	CIVresult_t res;
+	bool pending;
+
+	res = feedBytewise(freq7300,sizeof(freq7300),pending);
+	check(pending, "byte by byte: CIV_MSG_PENDING until the stop byte");
+	check((res.retVal==CIV_OK_DAV) && (res.address==CIV_ADDR_7300) && (res.value==7345000),
+		"byte by byte: frequency of the IC7300");
+
+	res = feedBytewise(ok7300,sizeof(ok7300),pending);
+	check((res.retVal==CIV_OK) && (res.address==CIV_ADDR_7300), "byte by byte: OK");
+
+	res = feedBytewise(nok7300,sizeof(nok7300),pending);
+	check((res.retVal==CIV_NOK) && (res.address==CIV_ADDR_7300), "byte by byte: NOK");
+
+	check(civ.readMsgRaw().retVal==CIV_NO_MSG, "nothing fed: CIV_NO_MSG");
+}
+
+//-------------------------------------------------------------------------------
+void testSplit() {
+	CIVresult_t res;
+	uint8_t two[sizeof(freq7300)+sizeof(ok7300)];
+
+	feed(freq7300,4);																			// FE FE E0 94
+	check(civ.readMsgRaw().retVal==CIV_MSG_PENDING, "split: first part -> CIV_MSG_PENDING");
+	feed(&freq7300[4],sizeof(freq7300)-4);
+	res = civ.readMsgRaw();
+	check((res.retVal==CIV_OK_DAV) && (res.value==7345000), "split: second part -> frame complete");
+
+	// two frames in one piece, the second one cut in the middle of the data
+	memcpy(two,ok7300,sizeof(ok7300));
+	memcpy(&two[sizeof(ok7300)],freq7300,sizeof(freq7300));
+	feed(two,sizeof(ok7300)+7);
+	check(civ.readMsgRaw().retVal==CIV_OK, "two frames in one piece: first one");
+	check(civ.readMsgRaw().retVal==CIV_MSG_PENDING, "two frames in one piece: second one pending");
+	feed(&two[sizeof(ok7300)+7],sizeof(freq7300)-7);
+	res = civ.readMsgRaw();
+	check((res.retVal==CIV_OK_DAV) && (res.value==7345000), "two frames in one piece: second one complete");
+}
+
+//-------------------------------------------------------------------------------
+void testPartial() {
+	CIVresult_t res;
+
+	feed(freq7300,6);																			// the rest never comes
+	check(civ.readMsgRaw().retVal==CIV_MSG_PENDING, "partial: pending within t_usRxFrame");
+	delay(2*t_usRxFrame/1000);
+	check(civ.readMsgRaw().retVal==CIV_NO_MSG, "partial: discarded after t_usRxFrame");
+
+	feed(ok7300,sizeof(ok7300));													// the receiver is ready for the next frame
+	res = civ.readMsgRaw();
+	check((res.retVal==CIV_OK) && (res.address==CIV_ADDR_7300), "partial: next frame OK");
+}
+
+//-------------------------------------------------------------------------------
+void testEcho() {
+	CIVresult_t res;
+	uint8_t out[64];
+	size_t len;
+
+	// writeMsg: the echo is read back and checked, it doesn't show up as a message
+	res = civ.writeMsg(CIV_ADDR_7300,CIV_C_F_READ,CIV_D_NIX,CIV_wChk);
+	check(res.retVal==CIV_OK, "writeMsg CIV_wChk: echo OK");
+	len = civ.transport().fetch(out,sizeof(out));
+	check((len==6) && (out[2]==CIV_ADDR_7300) && (out[3]==CIV_ADDR_MASTER) && (out[4]==CIV_C_F_READ[1]),
+		"writeMsg: frame on the bus");
+	check(civ.readMsgRaw().retVal==CIV_NO_MSG, "writeMsg: echo is not delivered as a message");
+
+	// answer after the echo: the echo is consumed, the answer is delivered
+	feed(freq7300,sizeof(freq7300));
+	res = civ.readMsg(CIV_ADDR_7300);
+	check((res.retVal==CIV_OK_DAV) && (res.value==7345000), "answer after writeMsg");
+
+	// writeMsgAsync: echo fed byte by byte together with the answer
+	civ.transport().setEcho(false);
+	CIVtxHandle_t handle = civ.writeMsgAsync(CIV_ADDR_7300,CIV_C_F_READ,CIV_D_NIX,CIV_wChk);
+	len = civ.transport().fetch(out,sizeof(out));
+	check((handle!=0) && (civ.writeStatus(handle)==CIV_TX_PENDING), "writeMsgAsync: pending without echo");
+	for (size_t idx=0; idx<len; idx++) {feed(&out[idx],1); civ.readMsgRaw();}
+	check(civ.writeStatus(handle)==CIV_OK, "writeMsgAsync: echo fed byte by byte -> CIV_OK");
+
+	// echo read late (after the time for the echo): still CIV_OK, polling writeStatus alone is enough
+	handle = civ.writeMsgAsync(CIV_ADDR_7300,CIV_C_MOD_READ,CIV_D_NIX,CIV_wChk);
+	len = civ.transport().fetch(out,sizeof(out));
+	feed(out,len);
+	delay(20);
+	uint8_t retVal;
+	for (int idx=0; ((retVal=civ.writeStatus(handle))==CIV_TX_PENDING) && (idx<100); idx++);
+	check(retVal==CIV_OK, "writeMsgAsync: echo read late -> CIV_OK");
+	civ.transport().setEcho(true);
+
+	// corrupted echo (collision): CIV_BUS_CONFLICT
+	civ.transport().setEcho(false);
+	civ.writeMsg(CIV_ADDR_7300,CIV_C_F_READ,CIV_D_NIX,CIV_wFast);
+	len = civ.transport().fetch(out,sizeof(out));
+	handle = civ.writeMsgAsync(CIV_ADDR_7300,CIV_C_MOD_READ,CIV_D_NIX,CIV_wChk);
+	civ.transport().fetch(out,sizeof(out));
+	out[3] ^= 0x55;
+	feed(out,6);
+	civ.readMsgRaw();
+	check(civ.writeStatus(handle)==CIV_BUS_CONFLICT, "writeMsgAsync: corrupted echo -> CIV_BUS_CONFLICT");
+	civ.transport().setEcho(true);
+	delay(2*t_usRxFrame/1000);
+	while (civ.readMsgRaw().retVal!=CIV_NO_MSG);
+}
+
+//-------------------------------------------------------------------------------
+void testMailboxes() {
+	CIVresult_t res;
+	uint8_t mixed[sizeof(freq705)+sizeof(freq9700)+sizeof(freq7300)];
+
+	civ.registerAddr(CIV_ADDR_705);
+	memcpy(mixed,freq705,sizeof(freq705));
+	memcpy(&mixed[sizeof(freq705)],freq9700,sizeof(freq9700));
+	memcpy(&mixed[sizeof(freq705)+sizeof(freq9700)],freq7300,sizeof(freq7300));
+	for (size_t idx=0; idx<sizeof(mixed); idx++) feed(&mixed[idx],1);
+
+	// one frame per call: the IC705 is kept in its mailbox, the IC9700 is discarded at the source address
+	check(civ.readMsg(CIV_ADDR_7300).retVal==CIV_NO_MSG, "readMsg: IC705 first -> not for the IC7300");
+	res = civ.readMsg(CIV_ADDR_7300);
+	check((res.retVal==CIV_OK_DAV) && (res.address==CIV_ADDR_7300), "readMsg: IC7300 behind IC705 and IC9700");
+	res = civ.readMsg(CIV_ADDR_705);
+	check((res.retVal==CIV_OK_DAV) && (res.value==144800000), "readMsg: IC705 out of its mailbox");
+	check(civ.readMsg(CIV_ADDR_9700).retVal==CIV_NO_MSG, "readMsg: IC9700 (not registered) discarded");
+	check(civ.readMsg(CIV_ADDR_705).retVal==CIV_NO_MSG, "readMsg: mailbox empty");
+	civ.unregisterAddr(CIV_ADDR_705);
+}
+
+//============================================================================================
+int main() {
+
+	printf("%s\n\n",VERSION_STRING);
+
+	civ.setupp();
+	civ.registerAddr(CIV_ADDR_7300);
+
+	testBytewise();
+	testSplit();
+	testPartial();
+	testEcho();
+	testMailboxes();
+
+	printf("\n%u check(s) failed\n", failed);
+	return failed;
+}
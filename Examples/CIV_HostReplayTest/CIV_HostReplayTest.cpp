@@ -0,0 +1,205 @@
+/*
+CIVmasterlib CIV_HostReplayTest - record the bus traffic with setCapture and replay it by CIVreplayTransport
+
+This is not a sketch - it runs on the host (no Arduino core, "useHost" in CIVmaster.h).
+The frames of two radios (and a few own commands) are fed into CIVmemTransport and recorded into a
+capture file (civ.setCapture). The capture is replayed by CIVreplayTransport - as fast as possible,
+from a point in time (seek via the index), with the address filter of the reader and with the original
+timing (speed 2.0) - and the frames decoded by readMsgRaw are compared with the ones of the recording.
+The exit code is the number of failed checks (0: everything OK).
+
+build and run (in this directory):
+	g++ -std=c++11 -O2 -I../.. ../../[A-Z]*.cpp CIV_HostReplayTest.cpp -o CIV_HostReplayTest -lpthread
+	./CIV_HostReplayTest
+
+*/
+
+/* includes -----------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "CIVcmds.h"
+#include "CIVmaster.h"
+
+// Global compile switches ===================================================================================
+
+#define VERSION_STRING "CIVmasterLib CIV_HostReplayTest V0_1 26/10/17"
+
+#define CAPTURE_FILE	"CIV_HostReplayTest.civcap"
+
+constexpr uint16_t	noOfFrames	= 700;			// more than two blocks of the index (CIVcapBlockSize)
+constexpr uint16_t	seekFrame		= 450;			// replay from this frame on (in the third block)
+
+//-------------------------------------------------------------------------------
+// create the civ object (recording)
+CIV     civ;
+
+uint16_t failed = 0;
+
+// a decoded frame
+typedef struct {
+	uint8_t				retVal;
+	uint8_t				address;
+	uint8_t				cmd;
+	unsigned long	value;
+} frame_t;
+
+std::vector<frame_t>	recorded;						// decoded while recording
+std::vector<uint64_t>	recordedTs;					// time of the frames in the capture
+
+//-------------------------------------------------------------------------------
+void check(const bool ok, const char name[]) {
+	printf("%-60s %s\n", name, ok ? "OK" : "FAILED");
+	if (!ok) failed++;
+}
+
+frame_t toFrame(const CIVresult_t &res) {
+	frame_t frame;
+
+	frame.retVal	= res.retVal;
+	frame.address	= res.address;
+	frame.cmd			= (res.cmd[0]>0) ? res.cmd[1] : 0;
+	frame.value		= res.value;
+	return frame;
+}
+
+bool sameFrames(const std::vector<frame_t> &a, const std::vector<frame_t> &b) {
+	if (a.size()!=b.size()) return false;
+	for (size_t idx=0; idx<a.size(); idx++) {
+		if ((a[idx].retVal!=b[idx].retVal) || (a[idx].address!=b[idx].address) ||
+				(a[idx].cmd!=b[idx].cmd) || (a[idx].value!=b[idx].value)) return false;
+	}
+	return true;
+}
+
+//-------------------------------------------------------------------------------
+// record the traffic of an IC7300 and an IC705 (frequencies, ModModes, OK/NOK) and some own commands
+void record() {
+	CIVcapture cap;
+	CIVcaptureReader reader;
+	CIVcapRec_t rec;
+	uint8_t frame[256];
+	uint8_t freq[]	= {0xFE,0xFE,0xE0,0x00,0x03,0x00,0x00,0x00,0x07,0x00,0xFD};
+	uint8_t mode[]	= {0xFE,0xFE,0xE0,0x00,0x04,0x01,0x02,0xFD};
+	uint8_t ack[]		= {0xFE,0xFE,0xE0,0x00,C_OK,0xFD};
+	CIVresult_t res;
+
+	check(cap.open(CAPTURE_FILE), "capture file opened");
+	civ.setCapture(&cap);
+
+	for (uint16_t idx=0; idx<noOfFrames; idx++) {
+		uint8_t addr = (idx%3==0) ? CIV_ADDR_705 : CIV_ADDR_7300;
+		switch (idx%5) {
+			case 0: case 1: case 2:
+				freq[3] = addr;
+				CIVbcd::encode(uint8_t(idx%100),&freq[5],1,CIV_bcdBigEndian);
+				CIVbcd::encode(uint8_t(idx/100),&freq[6],1,CIV_bcdBigEndian);
+				civ.transport().feed(freq,sizeof(freq));
+				break;
+			case 3:
+				mode[3] = addr; mode[5] = idx%4;
+				civ.transport().feed(mode,sizeof(mode));
+				break;
+			default:
+				ack[3] = addr; ack[4] = (idx%10==4) ? C_NOK : C_OK;
+				civ.transport().feed(ack,sizeof(ack));
+		}
+		res = civ.readMsgRaw();
+		if (res.retVal<=CIV_NOK) recorded.push_back(toFrame(res));
+
+		if (idx%50==25) civ.writeMsg(addr,CIV_C_F_READ,CIV_D_NIX,CIV_wChk);	// TX: not replayed
+		if (idx%10==9) delay(2);																		// some time on the bus
+	}
+
+	civ.setCapture(NULL);
+	cap.close();
+	check(recorded.size()==noOfFrames, "recording: all frames decoded");
+
+	// the times of the frames received (for seek)
+	if (reader.open(CAPTURE_FILE)) {
+		while (reader.next(rec,frame)) if (rec.evt==CIV_trRX) recordedTs.push_back(rec.ts);
+		check(reader.blocks()>2, "recording: index with several blocks");
+	}
+	check(recordedTs.size()==recorded.size(), "recording: one RX record per frame, TX recorded separately");
+}
+
+//-------------------------------------------------------------------------------
+// replay the capture and collect the frames decoded
+// ts: start of the replay (0: from the beginning), addr: address filter of the reader (CIV_ADDR_NONE: all)
+void replay(const double speed, const uint64_t ts, const uint8_t addr,
+						std::vector<frame_t> &frames, unsigned long &t_usReplay) {
+	CIVbus<CIVreplayTransport> rep;
+	CIVresult_t res;
+	unsigned long ts_start;
+
+	rep.setupp();
+	rep.registerAddr(CIV_ADDR_7300);
+	rep.registerAddr(CIV_ADDR_705);
+	frames.clear();
+
+	if (!rep.transport().open(CAPTURE_FILE, speed)) return;
+	if (ts>0) rep.transport().reader().seek(ts);
+	rep.transport().reader().setAddrFilter(addr);
+
+	ts_start = micros();
+	while (!rep.transport().done()) {
+		res = rep.readMsgRaw();
+		if (res.retVal<=CIV_NOK) frames.push_back(toFrame(res));
+	}
+	while ((res=rep.readMsgRaw()).retVal!=CIV_NO_MSG) {			// the rest of the receiver
+		if (res.retVal<=CIV_NOK) frames.push_back(toFrame(res));
+	}
+	t_usReplay = micros()-ts_start;
+}
+
+//-------------------------------------------------------------------------------
+void testReplay() {
+	std::vector<frame_t> frames, expected;
+	unsigned long t_us, t_usFast;
+
+	// as fast as possible: the same frames in the same order
+	replay(0, 0, CIV_ADDR_NONE, frames, t_usFast);
+	check(sameFrames(frames,recorded), "replay (speed 0): same frames as recorded");
+
+	// from a point in time on (binary search in the index)
+	replay(0, recordedTs[seekFrame], CIV_ADDR_NONE, frames, t_us);
+	expected.assign(recorded.begin()+seekFrame, recorded.end());
+	check(sameFrames(frames,expected), "replay after seek: the frames from this point in time on");
+
+	// one device only (blocks without the device are skipped)
+	replay(0, 0, CIV_ADDR_705, frames, t_us);
+	expected.clear();
+	for (size_t idx=0; idx<recorded.size(); idx++)
+		if (recorded[idx].address==CIV_ADDR_705) expected.push_back(recorded[idx]);
+	check(sameFrames(frames,expected), "replay with address filter: the frames of the IC705 only");
+
+	// original timing, twice as fast: the frames are fed in at their (scaled) time
+	unsigned long t_usCapture = (unsigned long)(recordedTs.back()-recordedTs.front());
+	replay(2.0, 0, CIV_ADDR_NONE, frames, t_us);
+	printf("capture %lu us, replay x2 %lu us, as fast as possible %lu us\n", t_usCapture, t_us, t_usFast);
+	check(sameFrames(frames,recorded), "replay (speed 2.0): same frames as recorded");
+	check((t_us>=t_usCapture/2*95/100) && (t_us<=t_usCapture/2*150/100+20000UL),
+		"replay (speed 2.0): half of the time of the capture");
+}
+
+//============================================================================================
+int main() {
+
+	printf("%s\n\n",VERSION_STRING);
+
+	civ.setupp();
+	civ.registerAddr(CIV_ADDR_7300);
+	civ.registerAddr(CIV_ADDR_705);
+
+	record();
+	if (recordedTs.size()>seekFrame) testReplay();
+	else check(false, "replay: nothing recorded");
+
+	remove(CAPTURE_FILE);
+	remove(CAPTURE_FILE ".idx");
+
+	printf("\n%u check(s) failed\n", failed);
+	return failed;
+}
@@ -0,0 +1,164 @@
+/*
+CIVmasterlib CIV_HostResyncTest - replay of a corrupted stream, resynchronisation of the receiver
+
+This is not a sketch - it runs on the host (no Arduino core, "useHost" in CIVmaster.h).
+A capture file with a damaged stream is written (CIVcapture): frames cut by a collision, followed
+immediately by the next frame (FE FE within a frame), oversized frames without FD, noise and preambles.
+It is replayed by CIVreplayTransport
+	- via the polling path (bulk ingest, CIVframer::collect(buf,len))
+	- via the receive ringbuffer (the bytes pushed in small pieces, as by the UART ISR)
+	- byte by byte through CIVframer::collect(inByte)
+and the number (and order) of the intact frames decoded is compared with the number written.
+The exit code is the number of failed checks (0: everything OK).
+
+build and run (in this directory):
+	g++ -std=c++11 -O2 -I../.. ../../[A-Z]*.cpp CIV_HostResyncTest.cpp -o CIV_HostResyncTest -lpthread
+	./CIV_HostResyncTest
+
+*/
+
+/* includes -----------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "CIVcmds.h"
+#include "CIVmaster.h"
+
+// Global compile switches ===================================================================================
+
+#define VERSION_STRING "CIVmasterLib CIV_HostResyncTest V0_1 26/10/17"
+
+#define CAPTURE_FILE	"CIV_HostResyncTest.civcap"
+
+constexpr uint16_t	noOfFrames	= 2000;			// intact frames in the capture
+constexpr uint8_t		pieceSize		= 13;				// bytes pushed into the ringbuffer at once
+
+uint16_t failed = 0;
+
+//-------------------------------------------------------------------------------
+void check(const bool ok, const char name[]) {
+	printf("%-60s %s\n", name, ok ? "OK" : "FAILED");
+	if (!ok) failed++;
+}
+
+void addBytes(CIVcapture &cap, const uint8_t bytes[], const uint8_t len) {
+	uint8_t frame[256];
+
+	frame[0] = len;
+	memcpy(&frame[1], bytes, len);
+	cap.add(CIV_trRX, CIV_OK, frame);
+}
+
+//-------------------------------------------------------------------------------
+// the corrupted stream: frequency frames of an IC705 (counting 0 .. noOfFrames-1 in the data),
+// every 5th one preceded by a frame cut by a collision, every 50th by an oversized frame, noise or a preamble
+bool writeCapture() {
+	CIVcapture cap;
+	uint8_t freq[11] = {0xFE,0xFE,0xE0,CIV_ADDR_705,0x00,0x00,0x50,0x34,0x07,0x00,0xFD};
+	uint8_t big[250];
+	const uint8_t noise[] = {0x12,0x34,0xFD,0x00};
+	const uint8_t preamble[] = {0xFE,0xFE,0xFE,0xFE,0xFE};
+
+	if (!cap.open(CAPTURE_FILE)) return false;
+
+	memset(big, 0x11, sizeof(big));
+	big[0] = big[1] = 0xFE; big[2] = 0xE0; big[3] = CIV_ADDR_705;
+
+	for (uint16_t idx=0; idx<noOfFrames; idx++) {
+		if (idx%5==4)		addBytes(cap, freq, 7);										// cut by a collision (no FD)
+		if (idx%50==10) {addBytes(cap, big, sizeof(big)); addBytes(cap, &big[4], 20);}	// oversized
+		if (idx%50==20) addBytes(cap, noise, sizeof(noise));
+		if (idx%50==30) addBytes(cap, preamble, sizeof(preamble));
+		CIVbcd::encode(uint8_t(idx%100),     &freq[5],1,CIV_bcdBigEndian);
+		CIVbcd::encode(uint8_t((idx/100)%100),&freq[6],1,CIV_bcdBigEndian);
+		addBytes(cap, freq, sizeof(freq));
+	}
+
+	cap.close();
+	return true;
+}
+
+//-------------------------------------------------------------------------------
+// replay the capture as fast as possible; useRing: the bytes are pushed into a receive ringbuffer
+// returns the no of intact frames decoded, outOfOrder: frames not following their predecessor
+uint16_t replay(const bool useRing, uint16_t &outOfOrder) {
+	CIVbus<CIVreplayTransport> rep;
+	CIVrxRing ring;
+	CIVresult_t res;
+	uint8_t piece[pieceSize];
+	uint16_t frames = 0, next = 0;
+
+	rep.setupp();
+	rep.registerAddr(CIV_ADDR_705);
+	if (useRing) rep.useRxRing(ring);
+	outOfOrder = 0;
+
+	if (!rep.transport().open(CAPTURE_FILE, 0)) return 0;
+
+	while (true) {
+		res = rep.readMsgRaw();
+		if (useRing && (res.retVal>CIV_NOK) && (rep.transport().available()>0)) {	// "ISR": the next piece
+			ring.push(piece, rep.transport().readBuf(piece, sizeof(piece)));
+			continue;
+		}
+		if ((res.retVal==CIV_OK_DAV) && (res.datafield[0]==5)) {
+			uint16_t value = CIVbcd::decode<uint16_t>(&res.datafield[1],2,CIV_bcdLittleEndian);
+			if (value!=next) outOfOrder++;
+			next = value+1;
+			frames++;
+		}
+		else if ((res.retVal==CIV_NO_MSG) && rep.transport().done()) break;
+	}
+	return frames;
+}
+
+//-------------------------------------------------------------------------------
+// the same bytes through CIVframer::collect(inByte)
+uint16_t replayBytewise() {
+	CIVcaptureReader reader;
+	CIVcapRec_t rec;
+	CIVframer framer;
+	uint8_t bytes[256];
+	uint16_t frames = 0;
+
+	if (!reader.open(CAPTURE_FILE)) return 0;
+	while (reader.next(rec, bytes)) {
+		for (uint8_t idx=0; idx<rec.len; idx++)
+			if (framer.collect(bytes[idx]) && (framer.rxBuffer[0]==11)) frames++;
+	}
+	return frames;
+}
+
+//============================================================================================
+int main() {
+
+	uint16_t frames, outOfOrder;
+	char name[80];
+
+	printf("%s\n\n",VERSION_STRING);
+
+	check(writeCapture(), "corrupted capture written");
+
+	frames = replay(false, outOfOrder);
+	printf("polling (bulk ingest): %u of %u frames\n", frames, noOfFrames);
+	snprintf(name, sizeof(name), "polling: all %u intact frames decoded", noOfFrames);
+	check(frames==noOfFrames, name);
+	check(outOfOrder==0, "polling: in the original order");
+
+	frames = replay(true, outOfOrder);
+	printf("ringbuffer (pieces of %u bytes): %u of %u frames\n", pieceSize, frames, noOfFrames);
+	snprintf(name, sizeof(name), "ringbuffer: all %u intact frames decoded", noOfFrames);
+	check(frames==noOfFrames, name);
+	check(outOfOrder==0, "ringbuffer: in the original order");
+
+	frames = replayBytewise();
+	snprintf(name, sizeof(name), "CIVframer byte by byte: all %u intact frames", noOfFrames);
+	check(frames==noOfFrames, name);
+
+	remove(CAPTURE_FILE);
+	remove(CAPTURE_FILE ".idx");
+
+	printf("\n%u check(s) failed\n", failed);
+	return failed;
+}
@@ -0,0 +1,149 @@
+/*
+CIVmasterlib CIV_HostRxRingStress - receive ringbuffer with a producer and a consumer thread
+
+This is not a sketch - it runs on the host (no Arduino core, "useHost" in CIVmaster.h).
+A producer thread pushes the frames of three devices into CIVrxRing, as the reader thread of
+startRxThread (or the UART callback of an ESP32) would do it: in pieces of random length, some of
+them byte by byte. Two devices are registered, the third one isn't. The consumer (main thread)
+takes the frames out via readMsgRaw and registers/unregisters another address from time to time,
+i.e. the address filter of the ringbuffer is changed while the producer is running.
+Checks:
+	- every frame of a registered device is either received or counted as an overrun
+	- per device, the frames arrive in the order they were sent and with the correct content
+	- no frame of the unregistered device is received
+The exit code is the number of failed checks (0: everything OK).
+Built with -fsanitize=thread, data races between the two threads are reported as well.
+
+build and run (in this directory):
+	g++ -std=c++11 -O2 -I../.. ../../[A-Z]*.cpp CIV_HostRxRingStress.cpp -o CIV_HostRxRingStress -lpthread
+	./CIV_HostRxRingStress [frames]
+
+*/
+
+/* includes -----------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <atomic>
+
+#include "CIVcmds.h"
+#include "CIVmaster.h"
+
+// Global compile switches ===================================================================================
+
+#define VERSION_STRING "CIVmasterLib CIV_HostRxRingStress V0_1 26/10/17"
+
+constexpr uint8_t ADDR[3]				= {CIV_ADDR_7300, CIV_ADDR_705, CIV_ADDR_7100};	// the last one is not registered
+constexpr uint8_t ADDR_CHURN		= 0x70;											// registered/unregistered by the consumer
+constexpr uint8_t FRAME_LENGTH	= 11;
+
+//-------------------------------------------------------------------------------
+// create the civ object
+CIV     civ;
+CIVrxRing	ring;
+
+std::atomic<bool>	producerDone {false};
+unsigned long			sent[3] = {0,0,0};							// written by the producer, read after join
+
+uint16_t failed = 0;
+
+//-------------------------------------------------------------------------------
+void check(const bool ok, const char name[]) {
+	printf("%-60s %s\n", name, ok ? "OK" : "FAILED");
+	if (!ok) failed++;
+}
+
+// frequency broadcast of device idx, the sequence number is the "frequency"
+void buildFrame(uint8_t frame[], const uint8_t idx, const unsigned long seq) {
+	const uint8_t head[5] = {0xFE,0xFE,0xE0,ADDR[idx],CIV_C_F_SEND[1]};
+
+	memcpy(frame,head,sizeof(head));
+	CIVbcd::encode(seq,&frame[5],5,CIV_bcdLittleEndian);
+	frame[10] = C_STOP;
+}
+
+//-------------------------------------------------------------------------------
+void producer(const unsigned long noOfFrames) {
+	uint8_t buf[8*FRAME_LENGTH];
+	uint32_t rnd = 12345;
+	unsigned long frames = 0;
+	size_t len, idx, piece;
+
+	while (frames<noOfFrames) {
+		len = 0;																						// up to 8 frames of the 3 devices
+		while ((len<sizeof(buf)) && (frames<noOfFrames)) {
+			rnd ^= rnd << 13; rnd ^= rnd >> 17; rnd ^= rnd << 5;
+			uint8_t dev = rnd%3;
+			buildFrame(&buf[len],dev,++sent[dev]);
+			len += FRAME_LENGTH; frames++;
+		}
+
+		for (idx=0; idx<len; idx+=piece) {									// in pieces of random length
+			rnd ^= rnd << 13; rnd ^= rnd >> 17; rnd ^= rnd << 5;
+			piece = 1 + rnd%(2*FRAME_LENGTH);
+			if (piece>len-idx) piece = len-idx;
+			if ((rnd&0x300)==0)																// sometimes byte by byte
+				for (size_t i=0; i<piece; i++) ring.push(buf[idx+i]);
+			else
+				ring.push(&buf[idx],piece);
+		}
+
+		if (ring.count()>=CIVrxRingSize-2) std::this_thread::yield();	// give the consumer a chance
+	}
+	producerDone = true;
+}
+
+//============================================================================================
+int main(int argc, char *argv[]) {
+
+	unsigned long noOfFrames	= (argc>1) ? atol(argv[1]) : 200000;
+	unsigned long received[3] = {0,0,0}, last[3] = {0,0,0};
+	unsigned long outOfOrder = 0, wrongValue = 0, churns = 0;
+	CIVresult_t res;
+	uint8_t dev;
+
+	printf("%s\n\n%lu frames\n\n",VERSION_STRING,noOfFrames);
+
+	civ.setupp();
+	civ.registerAddr(ADDR[0]);
+	civ.registerAddr(ADDR[1]);
+	civ.useRxRing(ring);
+	ring.setFrameTimeout(10000000UL);			// the producer may be preempted within a frame (esp. on one core)
+
+	std::thread producerThread(producer,noOfFrames);
+
+	while (true) {
+		bool done = producerDone;														// (before reading, so nothing is missed)
+		res = civ.readMsgRaw();
+		if (res.retVal==CIV_OK_DAV) {
+			for (dev=0; (dev<3) && (ADDR[dev]!=res.address); dev++);
+			if (dev>=3) {wrongValue++; continue;}
+			received[dev]++;
+			if (res.value<=last[dev]) outOfOrder++;
+			last[dev] = res.value;
+			if ((received[0]+received[1])%1000==0) {					// change the address filter meanwhile
+				if (civ.isAddrKnown(ADDR_CHURN))	civ.unregisterAddr(ADDR_CHURN);
+				else															civ.registerAddr(ADDR_CHURN);
+				churns++;
+			}
+		}
+		else if (done && (ring.count()==0) && (res.retVal==CIV_NO_MSG)) break;
+	}
+	producerThread.join();
+
+	unsigned long overruns = ring.overruns();
+	printf("sent %lu/%lu/%lu, received %lu/%lu/%lu, overruns %lu, filter changes %lu\n\n",
+		sent[0],sent[1],sent[2], received[0],received[1],received[2], overruns, churns);
+
+	check(uint16_t(received[0]+received[1]+overruns)==uint16_t(sent[0]+sent[1]),	// (overruns: 16 bit counter)
+		"every frame received or counted as overrun");
+	check((received[0]>0) && (received[1]>0), "frames of both registered devices received");
+	check(outOfOrder==0, "frames in the order sent");
+	check(wrongValue==0, "no frame of an unknown source");
+	check(received[2]==0, "frames of the unregistered device discarded");
+
+	printf("\n%u check(s) failed\n", failed);
+	return failed;
+}
@@ -35,7 +35,7 @@ Notes:
 //-------------------------------------------------------------------------------
 // create the civ and ICradio objects in use
 
-CIV     civ;    // create the CIV-Interface object
+CIVbus<CIVbtTransport> civ;    // create the CIV-Interface object (Bluetooth of the ESP32)
                 // ESP -> IC705 (via Bluetooth)
 
 //-------------------------------------------------------------------------------
@@ -54,6 +54,7 @@ uint8_t currentBCDsetting = 0xff; // 0xff == undefined
 
 bool    freqReceived = false; // initially, no frequency info has been received from the radio
 uint8_t freqPoll     = 0;     // number of initial frequency querys in addtion to the broadcast info
+CIVreqHandle_t freqReq = 0;   // handle of the pending frequency query (0: none)
 
 /* module wide variables ----------------------------------------------------*/
 
@@ -226,12 +227,22 @@ void loop() {
       } // Data available
     } // valid answer received
 
+    // ----------------------------------  answer to the frequency query (read via the handle, because the
+    // message in the mailbox may have been fetched by another part, which has sent the same query)
+    if ((freqReq!=0) && (civ.requestStatus(freqReq)!=CIV_TX_PENDING)) {
+      if (civ.requestResult(freqReq).retVal==CIV_OK_DAV) {
+        freqReceived = true;
+        set_PAbands(civ.requestResult(freqReq).value);
+      }
+      freqReq = 0;                                  // done or timeout
+    }
+
 
     // ----------------------------------  do a query for frequency, if necessary
     // poll every 500 * 10ms = 5sec until a valid frequency has been received
 
-    if ( (freqReceived == false) && ((lpCnt%500)==0) ) { 
-      civ.writeMsg (CIV_ADDR_705, CIV_C_F_READ, CIV_D_NIX, CIV_wChk);
+    if ( (freqReceived == false) && (freqReq == 0) && ((lpCnt%500)==0) ) { 
+      freqReq = civ.requestMsg (CIV_ADDR_705, CIV_C_F_READ, CIV_D_NIX);
       freqPoll++;
       Serial.print ("P ");
     }
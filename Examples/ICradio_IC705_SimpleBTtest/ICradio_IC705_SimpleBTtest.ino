@@ -17,9 +17,9 @@ Tasks:
 //-------------------------------------------------------------------------------
 // create the civ and ICradio objects in use
 
-CIV     civ;  // create the CIV-Interface object first (mandatory for the use of ICradio)
+CIVbus<CIVbtTransport> civ;  // create the CIV-Interface object first (Bluetooth of the ESP32, mandatory for ICradio)
 
-ICradio IC705(TypeIC705,CIV_ADDR_705);
+ICradio IC705(TypeIC705,CIV_ADDR_705,civ);
 
 //-------------------------------------------------------------------------------
 
@@ -40,8 +40,8 @@ This is deactivated by default due to saving data memory reasons.
 CIV     civ;  // create the CIV-Interface object first (mandatory for the use of ICradio)
 
 // create two ICradio objects for the two radios connected
-ICradio IC7300(TypeIC7300,CIV_ADDR_7300);
-ICradio IC9700(TypeIC9700,CIV_ADDR_9700);
+ICradio IC7300(TypeIC7300,CIV_ADDR_7300,civ);
+ICradio IC9700(TypeIC9700,CIV_ADDR_9700,civ);
 
 //-------------------------------------------------------------------------------
 
@@ -281,6 +281,9 @@ void setup() {
   IC7300.setupp(millis());            // initialize the ICradio class of radio 1
   IC9700.setupp(millis());            // initialize the ICradio class of radio 2
 
+  IC7300.setPushMode(true);           // both radios broadcast their changes (CI-V Transceive ON)
+  IC9700.setPushMode(true);           // -> no cyclic polling, as long as they are alive
+
   time_current_baseloop = millis();
   time_last_baseloop = time_current_baseloop;
   
@@ -53,18 +53,23 @@ This is deactivated by default due to saving data memory reasons.
 //-------------------------------------------------------------------------------
 // create the civ and ICradio objects in use
 
-CIV     civ;  // create the CIV-Interface object first (mandatory for the use of ICradio)
+// create the CIV-Interface object first (mandatory for the use of ICradio)
+#ifdef useIC705
+  CIVbus<CIVbtTransport> civ;         // Bluetooth (possible only on ESP32)
+#else
+  CIV     civ;                        // the serial interface of the board
+#endif
 
 #ifdef useIC705
-  ICradio ICxxxx(TypeIC705,CIV_ADDR_705);
+  ICradio ICxxxx(TypeIC705,CIV_ADDR_705,civ);
 #endif
 
 #ifdef useIC7300
-  ICradio ICxxxx(TypeIC7300,CIV_ADDR_7300);
+  ICradio ICxxxx(TypeIC7300,CIV_ADDR_7300,civ);
 #endif
 
 #ifdef useIC9700
-  ICradio ICxxxx(TypeIC9700,CIV_ADDR_9700);
+  ICradio ICxxxx(TypeIC9700,CIV_ADDR_9700,civ);
 #endif
 
 //-------------------------------------------------------------------------------
@@ -7,15 +7,14 @@
 */
 
 
-#include <Arduino.h>
+#if defined(ARDUINO)
+	#include <Arduino.h>
+#endif
 
 #include "CIVcmds.h"
 #include "CIVmaster.h"
 #include "ICradio.h"
 
-
-extern CIV civ;
-
 // definition of cyclic query modes
 #define noQuery				0
 #define	query_mod 		1
@@ -24,9 +23,10 @@ extern CIV civ;
 #define	query_3_f_mod 6
 
 //ctor = constructor
-	ICradio::ICradio(radioType_t thisRadio, uint8_t myCIVaddr) :
-	_radioType(thisRadio),_radioAddr(myCIVaddr),_radioMode(MODE_NDEF),_radioOnOffState(RADIO_NDEF),
-	_waitForAnswer(false),_waitForIDquery(false),_DateTimeSent(false),_fModQuery(noQuery),_frequency(0),
+	ICradio::ICradio(radioType_t thisRadio, uint8_t myCIVaddr, CIVbase &bus) :
+	_civ(&bus),_radioType(thisRadio),_radioAddr(myCIVaddr),_radioMode(MODE_NDEF),_radioOnOffState(RADIO_NDEF),
+	_waitForAnswer(false),_waitForIDquery(false),_DateTimeSent(false),_dateTimeNext(3),_fModQuery(noQuery),
+	_fReq(0),_modReq(0),_pushMode(false),_pushActive(false),_rxSeen(false),_broadcastSeen(false),_pollsSaved(0),_frequency(0),
 	_modMode(MOD_NDEF),_modFilter(FIL_NDEF),_sequMode(MODE_NDEF)
 
 	{
@@ -41,18 +41,20 @@ extern CIV civ;
     _ts_lastIDquery  = currentTime;
     _ts_waitForAnswer   = currentTime;
     _ts_lastOnCmd       = currentTime;
+    _ts_lastRx          = currentTime - t_pushQuiet - 1;		// nothing received yet
+    _ts_lastBroadcast   = _ts_lastRx;
 
-		civ.registerAddr(_radioAddr);
+		_civ->registerAddr(_radioAddr);
 
 	}
 
   //::::::::::::: get the CIV-answers from the radio
   CIVresult_t ICradio::getNewMsg() {
-		CIVresult_t radioMsg;
-		
 		// -----------------------------------------------------------------------------------
 		// get an answer from the radio, do the low level processing and store it into radioMsg
-		radioMsg = civ.readMsg(_radioAddr);
+		// (radioMsg is a view of the message in civ's buffer, the slot is released at the end of getNewMsg)
+		CIVmsgRef msg = _civ->readMsgRef(_radioAddr);
+		const CIVresult_t &radioMsg = *msg;
 //		if (radioMsg.retVal <= CIV_NOK) {
 //    	Serial.print (_radioType);Serial.print("  -  ");Serial.println (radioMsg.retVal);    
 //		}
@@ -60,6 +62,14 @@ extern CIV civ;
 
 		// -----------------------------------------------------------------------------------
 		// evaluate the received message from the radio
+
+		// any frame from the radio proves, that it is alive (except NOK: IC9700 answers with NOK, if it is off)
+		if ((radioMsg.retVal==CIV_OK) || (radioMsg.retVal==CIV_OK_DAV)) {
+			_rxSeen = true;
+			if ((radioMsg.cmd[1]==CIV_C_F_SEND[1]) || (radioMsg.cmd[1]==CIV_C_MOD_SEND[1]))
+				_broadcastSeen = true;
+		}
+
 		if (radioMsg.retVal==CIV_OK)  {
 			_waitForAnswer = false;
 		}
@@ -77,28 +87,7 @@ extern CIV civ;
     if (radioMsg.retVal==CIV_OK_DAV) {           // data for evaluation available
 			_waitForAnswer = false;
 
-			// ...................................................................................
-      if ((radioMsg.cmd[1]==CIV_C_F_SEND[1]) || // frequency broadcast from radio received
-          (radioMsg.cmd[1]==CIV_C_F_READ[1]))		// frequency query answered
-        {
-          _frequency = radioMsg.value;
-					// Serial.println (_frequency);
-        }
-			// ...................................................................................
-      if ((radioMsg.cmd[1]==CIV_C_MOD_SEND[1]) || // ModMode broadcast from radio received
-          (radioMsg.cmd[1]==CIV_C_MOD_READ[1]))		// ModMode  query answered
-        {
-					if (radioMsg.datafield[1] == 0x17) 			// DV is coded in BCD according to ICOM
-						_modMode = MOD_DV;
-					else
-						_modMode = radioModMode_t(radioMsg.datafield[1]);
-					if (_modMode > MOD_NDEF) _modMode = MOD_NDEF;
-					
-					if (radioMsg.datafield[0]==2)						// Filter info has been sent as well
-						_modFilter = radioFilter_t(radioMsg.datafield[2]);					
-					if (_modFilter > FIL3) _modFilter = FIL_NDEF;
-					
-        }
+			evalData(radioMsg);										// frequency, ModMode
 			// ...................................................................................
       if ((radioMsg.cmd[1]==CIV_C_TRX_ID[1]) && 	// radio id received
           (radioMsg.cmd[2]==CIV_C_TRX_ID[2])) {
@@ -126,21 +115,53 @@ extern CIV civ;
 		// -----------------------------------------------------------------------------------
 		// send a query for frequency and ModMode/RX-Filter to the Radio if requested
     if (_fModQuery>noQuery) {
+			// both queries are in flight at the same time - civ assigns the answers to the requests, a slow
+			// answer (e.g. IC9700) is covered by the deadline + retry of the request instead of waiting loopticks
+			// (no echo check for the polls - a query lost on the bus is covered by the retry as well)
 			if (_fModQuery==query_f_mod) {
-				civ.writeMsg(_radioAddr,CIV_C_F_READ,CIV_D_NIX,CIV_wChk);		// ask for the frequency
+				sendQuery(_fReq,CIV_C_F_READ);			// ask for the frequency
+				sendQuery(_modReq,CIV_C_MOD_READ);	// ask for the ModMode and Filterinfo
+				_fModQuery = noQuery;
 			}
-			// delay of two loopticks (20ms) because of slow IC9700 reaction!
-
-			if (_fModQuery==query_mod) {
-				civ.writeMsg(_radioAddr,CIV_C_MOD_READ,CIV_D_NIX,CIV_wChk);	// ask for the ModMode and Filterinfo
+			else {
+				if (_fModQuery==query_mod) {
+					sendQuery(_modReq,CIV_C_MOD_READ);	// ask for the ModMode and Filterinfo
+				}
+				_fModQuery--;
 			}
-			_fModQuery--;
 		}
 
+		// -----------------------------------------------------------------------------------
+		// queue the rest of the date_time commands, if the queue has been full
+		if (_dateTimeNext<3) sendDateTime();
+
+		// -----------------------------------------------------------------------------------
+		// answers to the queries (before the messages of the mailbox: a newer broadcast wins)
+		getQueryResult(_fReq);
+		getQueryResult(_modReq);
+
 		// -----------------------------------------------------------------------------------
 		// get and process messages / answers from the readio
 				radioMsg = getNewMsg();
 
+		if (_rxSeen) {
+			_ts_lastRx = currentTime;
+			_rxSeen = false;
+		}
+		if (_broadcastSeen) {
+			_ts_lastBroadcast = currentTime;
+			_broadcastSeen = false;
+
+			// push mode: broadcasts of a radio, which is regarded as OFF, mean, it has been switched on
+			if (_pushMode && (_radioOnOffState!=RADIO_ON) && (_radioOnOffState!=RADIO_ON_TR) &&
+					(_waitForIDquery==false)) {
+				_civ->writeMsgAsync(_radioAddr,CIV_C_TRX_ID,CIV_D_NIX,CIV_wFast,CIV_prioPoll);	// confirm by the ID
+				_waitForIDquery = true;
+				_ts_lastIDquery = currentTime;
+			}
+		}
+		_pushActive = _pushMode && (_radioOnOffState==RADIO_ON) && ((currentTime-_ts_lastBroadcast)<t_pushQuiet);
+
 		// -----------------------------------------------------------------------------------
 		// check ON/OFF state timeout processing
     if (_waitForIDquery == true) {                               // still waiting for an ID query-answer 
@@ -154,8 +175,16 @@ extern CIV civ;
 
 		// -----------------------------------------------------------------------------------
 		// cyclic check for the availability of the radio
+    if (((currentTime-_ts_lastIDquery)>t_RadioCheck) && (_sequMode==MODE_NDEF) &&
+				_pushMode && (_radioOnOffState==RADIO_ON) && ((currentTime-_ts_lastRx)<t_pushQuiet)) {
+			// push mode: the radio is alive -> no ID query; frequency and modMode only, if not broadcast
+      _ts_lastIDquery = currentTime;
+			_pollsSaved++;
+			if (_pushActive)	_pollsSaved++;
+			else							_fModQuery = query_3_f_mod;
+    }
     if (((currentTime-_ts_lastIDquery)>t_RadioCheck) && (_sequMode==MODE_NDEF)) {     // it's time to send an ID query command to the radio
-      civ.writeMsg(_radioAddr,CIV_C_TRX_ID,CIV_D_NIX,CIV_wFast);
+      _civ->writeMsgAsync(_radioAddr,CIV_C_TRX_ID,CIV_D_NIX,CIV_wFast,CIV_prioPoll);	// background poll
       _waitForIDquery = true;
       _ts_lastIDquery = currentTime;
 			// Serial.print("sendIDquery  "); Serial.print(_radioType); Serial.print(" * "); Serial.println(_radioOnOffState,HEX);
@@ -169,7 +198,7 @@ extern CIV civ;
     if (_sequMode!=MODE_NDEF) {                                      // set mode sequence requested
 
       if ((_sequCmdIdx<_sequNoOfCmds) && (_waitForAnswer==false)) {  // new command after ack to be sent
- 				civ.writeMsg(_radioAddr,_sequPntr,CIV_D_NIX,CIV_wFast);
+ 				_civ->writeMsgAsync(_radioAddr,_sequPntr,CIV_D_NIX,CIV_wFast,CIV_prioUser);
 				_waitForAnswer = true;
 				_sequPntr=_sequPntr + SEQU_MAX_CMD_LENGTH;		// next command in sequence
         _sequCmdIdx++;
@@ -186,7 +215,7 @@ extern CIV civ;
 
 			_fModQuery = query_1_mod;	// trigger the query for modMode after Mode change with delay of 1 looptick
 
-			// civ.logDisplay();
+			// _civ->logDisplay();
       }
 
     }
@@ -195,6 +224,68 @@ extern CIV civ;
 
 	}
 
+  //::::::::::::: take over frequency, ModMode and Filterinfo (broadcast or answer to a query)
+	void ICradio::evalData(const CIVresult_t &radioMsg) {
+
+      if ((radioMsg.cmd[1]==CIV_C_F_SEND[1]) || // frequency broadcast from radio received
+          (radioMsg.cmd[1]==CIV_C_F_READ[1]))		// frequency query answered
+        {
+          _frequency = radioMsg.value;
+					// Serial.println (_frequency);
+        }
+			// ...................................................................................
+      if ((radioMsg.cmd[1]==CIV_C_MOD_SEND[1]) || // ModMode broadcast from radio received
+          (radioMsg.cmd[1]==CIV_C_MOD_READ[1]))		// ModMode  query answered
+        {
+					if (radioMsg.datafield[1] == 0x17) 			// DV is coded in BCD according to ICOM
+						_modMode = MOD_DV;
+					else
+						_modMode = radioModMode_t(radioMsg.datafield[1]);
+					if (_modMode > MOD_NDEF) _modMode = MOD_NDEF;
+					
+					if (radioMsg.datafield[0]==2)						// Filter info has been sent as well
+						_modFilter = radioFilter_t(radioMsg.datafield[2]);					
+					if (_modFilter > FIL3) _modFilter = FIL_NDEF;
+					
+        }
+
+	}
+
+  //::::::::::::: answer to a query of frequency or ModMode (requests of civ, see sendQuery)
+	void ICradio::getQueryResult(CIVreqHandle_t &req) {
+		// the answer is read via the handle, because civ's mailbox delivers a message only once: if the query
+		// has been merged with the same query of another part of the application (t_usCoalesce), the message
+		// may have been fetched by the other part already
+		if ((req==0) || (_civ->requestStatus(req)==CIV_TX_PENDING)) return;
+		const CIVresult_t &result = _civ->requestResult(req);
+		if (result.retVal==CIV_OK_DAV) {
+			_rxSeen = true;
+			evalData(result);
+		}
+		req = 0;																				// done, timeout or handle reused
+	}
+
+  //::::::::::::: query of frequency or ModMode as a request of civ
+	void ICradio::sendQuery(CIVreqHandle_t &req, const uint8_t cmd_body[]) {
+		// the previous query is still pending (retry included) -> no second one, it would only occupy
+		// another entry of the request table (CIVreqTableSize) until its timeout
+		if ((req!=0) && (_civ->requestStatus(req)==CIV_TX_PENDING)) return;
+		req = _civ->requestMsg(_radioAddr,cmd_body,CIV_D_NIX,t_usRequest,1,CIV_prioPoll,CIV_wFast);
+	}
+
+  //::::::::::::: push mode: state tracking driven by the transceive broadcasts of the radio
+	void ICradio::setPushMode(bool on) {
+		_pushMode = on;
+	}
+
+	bool ICradio::getPushActive() {
+		return _pushActive;
+	}
+
+	uint16_t ICradio::getPollsSaved() {
+		return _pollsSaved;
+	}
+
   //::::::::::::: check, wether radio is switched on and connected
   radioOnOff_t ICradio::getAvailability() {
     return _radioOnOffState;
@@ -223,7 +314,7 @@ extern CIV civ;
       // special write sequence according to ICOM manual because of 
       // possible standby of the radio
 
-      civ.writeMsg(_radioAddr,CIV_C_TRX_ON_OFF,CIV_D_ON,CIV_wOn);
+      _civ->writeMsgAsync(_radioAddr,CIV_C_TRX_ON_OFF,CIV_D_ON,CIV_wOn,CIV_prioUrgent);	// ahead of any polling
       _radioOnOffState         = RADIO_OFF_TR;
       _waitForAnswer      = true;
       _ts_waitForAnswer   = currentTime;
@@ -231,7 +322,7 @@ extern CIV civ;
     }
 
     if (task==2) { // ON  -> OFF
-      civ.writeMsg(_radioAddr,CIV_C_TRX_ON_OFF,CIV_D_OFF,CIV_wFast);
+      _civ->writeMsgAsync(_radioAddr,CIV_C_TRX_ON_OFF,CIV_D_OFF,CIV_wFast,CIV_prioUrgent);
       _radioOnOffState         = RADIO_ON_TR;
       _waitForAnswer      = true;
       _ts_waitForAnswer   = currentTime;
@@ -306,11 +397,31 @@ extern CIV civ;
 
 	}
 
+	void ICradio::updateDateTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t minute,
+															 int16_t UTCdeltaMin) {
+		uint8_t timeArr[3]		= {2};
+		uint8_t dateArr[5]		= {4};
+		uint8_t UTCdeltaArr[4]	= {3};
+
+		CIVbcd::encode(uint8_t(hour),  &timeArr[1],1,CIV_bcdBigEndian);
+		CIVbcd::encode(uint8_t(minute),&timeArr[2],1,CIV_bcdBigEndian);
+		CIVbcd::encode(year,           &dateArr[1],2,CIV_bcdBigEndian);
+		CIVbcd::encode(uint8_t(month), &dateArr[3],1,CIV_bcdBigEndian);
+		CIVbcd::encode(uint8_t(day),   &dateArr[4],1,CIV_bcdBigEndian);
+
+		UTCdeltaArr[3] = (UTCdeltaMin<0) ? 0x01 : 0x00;			// direction: 0x00 ahead, 0x01 behind
+		if (UTCdeltaMin<0) UTCdeltaMin = -UTCdeltaMin;
+		CIVbcd::encode(uint8_t(UTCdeltaMin/60),&UTCdeltaArr[1],1,CIV_bcdBigEndian);
+		CIVbcd::encode(uint8_t(UTCdeltaMin%60),&UTCdeltaArr[2],1,CIV_bcdBigEndian);
+
+		updateDateTime(timeArr,dateArr,UTCdeltaArr);
+	}
+
   //::::::::::::: set date_time (send data to radio)
 	void ICradio::setDateTime() {
-    civ.writeMsg(_radioAddr,CIV_C_UTC,  _UTCdelta,CIV_wChk);
-    civ.writeMsg(_radioAddr,CIV_C_TIME, _time,		CIV_wChk);
-    civ.writeMsg(_radioAddr,CIV_C_DATE, _date,		CIV_wChk);
+		// no need to wait for the three commands - they are sent and checked in the background
+		_dateTimeNext = 0;
+		sendDateTime();
 		_DateTimeSent=true;
 	}
 
@@ -331,9 +442,9 @@ extern CIV civ;
 
   //::::::::::::: set/get the CI-V address
   void ICradio::setCIVaddr(uint8_t myCIVaddr) {
-		civ.unregisterAddr(_radioAddr);
+		_civ->unregisterAddr(_radioAddr);
 		_radioAddr = myCIVaddr;
-		civ.registerAddr(_radioAddr);
+		_civ->registerAddr(_radioAddr);
 	}
 	
   uint8_t ICradio::getCIVaddr() {
@@ -343,6 +454,18 @@ extern CIV civ;
 //------------------------------------------------------------------------
 // private methods
 
+  //::::::::::::: queue the date_time commands not queued yet
+	void ICradio::sendDateTime() {
+		const uint8_t *cmd[3]  = {CIV_C_UTC, CIV_C_TIME, CIV_C_DATE};
+		const uint8_t *data[3] = {_UTCdelta, _time,      _date};
+
+		while (_dateTimeNext<3) {
+			// the queue may be full (e.g. CIVtxQueueSize=2 on AVR) -> the rest is queued by the next loopp
+			if (_civ->writeMsgAsync(_radioAddr,cmd[_dateTimeNext],data[_dateTimeNext],CIV_wChk)==0) return;
+			_dateTimeNext++;
+		}
+	}
+
 	
 //------------------------------------------------------------------------
 // private static variables
@@ -19,6 +19,7 @@
 // some timing definitions (based on ms)
 #define t_waitForAnswer 100
 #define t_RadioCheck    1800
+#define t_pushQuiet     t_RadioCheck	// push mode: no frame from the radio within this time -> polling again
 
 constexpr long unsigned t_radio_OFF_TR[4] = {
 	5000, // boot time of the IC7100
@@ -87,7 +88,8 @@ class ICradio {
 public:
 
 // ctor = constructor
-  ICradio(radioType_t thisRadio, uint8_t myCIVaddr);
+  ICradio(radioType_t thisRadio, uint8_t myCIVaddr, CIVbase &bus);
+	// bus: the CIV object (i.e. the interface) the radio is connected to, e.g. the object "civ" of the sketch
       
 //------------------------------------------------------------------------
 // public member functions
@@ -115,6 +117,9 @@ public:
 		// timeArr[3]       = {2, 0x20, 0x44};              // 20:44
 		// dateArr[5]       = {4, 0x20, 0x22, 0x11, 0x06};  // 2022-11-06
 		// UTCdeltaArr[4]   = {3, 0x01,0x00,0x00};          // 1h ahead
+	void 				updateDateTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t minute,
+														 int16_t UTCdeltaMin);
+		// same with binary values, e.g. (2022,11,6, 20,44, 60) - the BCD fields are built by CIVbcd
 
   //::::::::::::: set date_time (send time data to radio)
 	void 				setDateTime();
@@ -132,6 +137,19 @@ public:
   void setCIVaddr(uint8_t myCIVaddr);
 	
   uint8_t getCIVaddr();
+
+  //::::::::::::: push mode: state tracking driven by the transceive broadcasts of the radio
+	void				setPushMode(bool on);
+	bool				getPushActive();				// true, if the broadcasts of the radio are being received
+	uint16_t		getPollsSaved();				// no of ID queries and f/mod queries suppressed so far
+	/*
+	With the transceive function of the radio switched on (CI-V Transceive = ON), every change of the
+	frequency or ModMode is broadcast by the radio (CIV_C_F_SEND/CIV_C_MOD_SEND).
+	In push mode, any frame received from the radio counts as proof that it is switched on, so the cyclic
+	ID query is suppressed, as long as the radio doesn't go quiet for more than t_pushQuiet.
+	As long as broadcasts come in, the cyclic query of frequency and ModMode is suppressed as well.
+	If the radio goes quiet, ICradio falls back to polling (default mode, setPushMode(false)).
+	*/
 	
 	  //::::::::::::: get and process the CIV-answers from the radio
   CIVresult_t getNewMsg();
@@ -142,10 +160,15 @@ private:
 //------------------------------------------------------------------------
 // private methods
 
+	void				sendDateTime();					// queue the date_time commands not queued yet (see setDateTime)
+	void				sendQuery(CIVreqHandle_t &req, const uint8_t cmd_body[]);	// request, unless req is still pending
+	void				getQueryResult(CIVreqHandle_t &req);		// evaluate the answer of req, if it's done
+	void				evalData(const CIVresult_t &radioMsg);	// frequency, ModMode and Filterinfo
 
 //------------------------------------------------------------------------
 // private variables
 
+	CIVbase         *_civ;
 	radioType_t     _radioType;
   uint8_t         _radioAddr;
   radioMode_t     _radioMode;
@@ -153,7 +176,15 @@ private:
   bool            _waitForAnswer;
   bool            _waitForIDquery;
 	bool						_DateTimeSent;
+	uint8_t					_dateTimeNext;		// next date_time command to be queued (3: all of them queued)
 	uint8_t					_fModQuery;
+	CIVreqHandle_t	_fReq;						// handles of the pending queries of frequency and ModMode
+	CIVreqHandle_t	_modReq;
+	bool						_pushMode;
+	bool						_pushActive;
+	bool						_rxSeen;					// a frame from the radio has been received during this looptick
+	bool						_broadcastSeen;		// a broadcast from the radio has been received during this looptick
+	uint16_t				_pollsSaved;
   
   unsigned long   _frequency;
 	radioModMode_t	_modMode;
@@ -172,6 +203,8 @@ private:
   unsigned long   _ts_lastIDquery;
   unsigned long   _ts_waitForAnswer;
   unsigned long   _ts_lastOnCmd;
+  unsigned long   _ts_lastRx;
+  unsigned long   _ts_lastBroadcast;
 
 }; // end class ICradio
 